@@ -0,0 +1,134 @@
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "sys/socket.h"
+#include "unistd.h"
+
+#include "spinet.h"
+#include "util.h"
+
+// compares the kernel hash of the reuseport listeners with the cpu steering, by the echo round trips per second
+// of blocking clients which connect to an in-process server
+
+constexpr std::size_t MESSAGE_SIZE = 64;
+
+void echo(std::shared_ptr<spinet::TcpSocket> socket) {
+    socket->async_read_some([socket](spinet::Result res, spinet::Buffer buffer) {
+        if (!res) {
+            socket->close();
+            return;
+        }
+        socket->async_write(std::move(buffer), [socket](spinet::Result res, std::size_t size) {
+            if (!res) {
+                socket->close();
+                return;
+            }
+            echo(socket);
+        });
+    });
+}
+
+void run_client(spinet::Address address, std::atomic<bool>& stopped, std::atomic<uint64_t>& round_trips) {
+    int fd = ::socket(address.sockaddr()->sa_family, SOCK_STREAM, 0);
+    if (fd == -1 || ::connect(fd, address.sockaddr(), address.sockaddr_length()) == -1) {
+        std::cerr << "client cannot connect, reason:" << std::strerror(errno) << std::endl;
+        if (fd != -1) {
+            ::close(fd);
+        }
+        return;
+    }
+    uint8_t message[MESSAGE_SIZE] {};
+    uint64_t count = 0;
+    while (!stopped) {
+        if (::send(fd, message, MESSAGE_SIZE, MSG_NOSIGNAL) != MESSAGE_SIZE) {
+            break;
+        }
+        std::size_t received = 0;
+        while (received < MESSAGE_SIZE) {
+            auto bytes = ::recv(fd, message + received, MESSAGE_SIZE - received, 0);
+            if (bytes <= 0) {
+                break;
+            }
+            received = received + bytes;
+        }
+        if (received < MESSAGE_SIZE) {
+            break;
+        }
+        count++;
+    }
+    round_trips += count;
+    ::close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 7) {
+        std::cerr << "Usage: PROGRAM_NAME ${address} ${port} ${worker_threads} ${clients} ${seconds} ${hash|steer}"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto port = expectInt(argv[2], "port is an invalid number.");
+    if (port < 0 || port > 65535) {
+        std::cerr << "port should be between 0 and 65535." << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto address = spinet::Address::parse(argv[1], port);
+    if (address.index() == 1) {
+        std::cerr << std::get<1>(address) << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto worker_threads = expectInt(argv[3], "worker_threads is an invalid number.");
+    if (worker_threads <= 0) {
+        std::cerr << "worker_threads should be greater than 0." << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto clients = expectInt(argv[4], "clients is an invalid number.");
+    if (clients <= 0) {
+        std::cerr << "clients should be greater than 0." << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto seconds = expectInt(argv[5], "seconds is an invalid number.");
+    if (seconds <= 0) {
+        std::cerr << "seconds should be greater than 0." << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string mode { argv[6] };
+    if (mode != "hash" && mode != "steer") {
+        std::cerr << "mode should be hash or steer." << std::endl;
+        return EXIT_FAILURE;
+    }
+    spinet::Server server {};
+    spinet::Server::Settings settings { .workers = (uint16_t)worker_threads, .reuse_port = false };
+    settings.cpu_steering = mode == "steer";
+    auto error = server.with_settings(settings);
+    if (error) {
+        std::cerr << error.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    error = server.listen_tcp_endpoint(std::get<0>(address), echo);
+    if (error) {
+        std::cerr << error.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    error = server.run();
+    if (error) {
+        std::cerr << error.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::atomic<bool> stopped { false };
+    std::atomic<uint64_t> round_trips { 0 };
+    std::vector<std::thread> threads {};
+    for (int i = 0; i < clients; i++) {
+        threads.emplace_back(run_client, std::get<0>(address), std::ref(stopped), std::ref(round_trips));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds { seconds });
+    stopped = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    server.stop();
+    std::cout << "mode=" << mode << " workers=" << worker_threads << " clients=" << clients
+              << " round_trips_per_second=" << round_trips / seconds << std::endl;
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
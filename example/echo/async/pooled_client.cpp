@@ -0,0 +1,113 @@
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+#include "spinet.h"
+#include "util.h"
+
+// sends each round trip over a warm connection leased from the pool, instead of a new connection per operation
+
+int main(int argc, char* argv[]) {
+    if (argc != 7) {
+        std::cerr << "Usage: PROGRAM_NAME ${address} ${port} ${worker_threads} ${connections} ${times} ${payload_size}"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto port = expectInt(argv[2], "port is an invalid number.");
+    if (port < 0 || port > 65535) {
+        std::cerr << "port should be between 0 and 65535." << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto address = spinet::Address::parse(argv[1], port);
+    if (address.index() == 1) {
+        std::cerr << std::get<1>(address) << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto worker_threads = expectInt(argv[3], "worker_threads is an invalid number.");
+    if (worker_threads <= 0) {
+        std::cerr << "worker_threads should be greater than 0." << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto connections = expectInt(argv[4], "connections is an invalid number.");
+    if (connections <= 0) {
+        std::cerr << "connections should be greater than 0." << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto times = expectInt(argv[5], "times is an invalid number.");
+    if (times <= 0) {
+        std::cerr << "times should be greater than 0." << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto payload_size = expectInt(argv[6], "payload_size is an invalid number.");
+    if (payload_size <= 0) {
+        std::cerr << "payload_size should be greater than 0." << std::endl;
+        return EXIT_FAILURE;
+    }
+    spinet::Client client {};
+    spinet::Client::Settings settings { .workers = (uint16_t)worker_threads, .reuse_port = false };
+    settings.placement = spinet::Placement::LEAST_CONNECTIONS;
+    if (auto error = client.with_settings(settings)) {
+        std::cerr << error.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (auto error = client.run()) {
+        std::cerr << error.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    spinet::ConnectionPool pool { client };
+    auto pool_settings = spinet::ConnectionPool::Settings::default_settings();
+    pool_settings.connections = connections;
+    if (auto error = pool.with_settings(pool_settings)) {
+        std::cerr << error.value() << std::endl;
+        client.stop();
+        return EXIT_FAILURE;
+    }
+    auto res = pool.add_destination(std::get<0>(address));
+    if (res.index() == 1) {
+        std::cerr << std::get<1>(res) << std::endl;
+        client.stop();
+        return EXIT_FAILURE;
+    }
+    auto destination = std::get<0>(res);
+    std::atomic<uint64_t> finishedCount { 0 };
+    std::atomic<uint64_t> failedCount { 0 };
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < (std::size_t)times;) {
+        // the lease is shared by the callbacks, and the connection goes back to the pool with the last of them
+        auto lease = std::make_shared<spinet::ConnectionPool::Lease>(destination->lease());
+        if (!*lease) {
+            // all the connections are busy or still connecting
+            std::this_thread::yield();
+            continue;
+        }
+        i++;
+        auto socket = lease->socket();
+        std::shared_ptr<uint8_t[]> buffer { new uint8_t[payload_size] };
+        memset(buffer.get(), 'a', payload_size);
+        socket->async_write(buffer.get(), payload_size,
+        [&finishedCount, &failedCount, lease, socket, buffer, payload_size](spinet::Result res, std::size_t size) {
+            if (!res) {
+                socket->close();
+                failedCount++;
+                return;
+            }
+            socket->async_read(buffer.get(), payload_size,
+            [&finishedCount, &failedCount, lease, socket, buffer](spinet::Result res, std::size_t size) {
+                if (!res) {
+                    socket->close();
+                    failedCount++;
+                    return;
+                }
+                finishedCount++;
+            });
+        });
+    }
+    while (finishedCount + failedCount < (uint64_t)times) {
+        std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    client.stop();
+    std::cerr << "finished: " << finishedCount << ", failed: " << failedCount << ", elapsed: " << elapsed.count()
+              << "ms" << std::endl;
+    return EXIT_SUCCESS;
+}
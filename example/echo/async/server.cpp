@@ -3,26 +3,27 @@
 #include "spinet.h"
 #include "util.h"
 
-void read_callback(spinet::Result res, std::size_t size, std::shared_ptr<spinet::TcpSocket> socket, std::shared_ptr<uint8_t[]> buffer);
+void read_callback(spinet::Result res, spinet::Buffer buffer, std::shared_ptr<spinet::TcpSocket> socket, std::size_t payload_size);
 
-void write_callback(spinet::Result res, std::size_t size, std::shared_ptr<spinet::TcpSocket> socket, std::shared_ptr<uint8_t[]> buffer);
+void write_callback(spinet::Result res, std::size_t size, std::shared_ptr<spinet::TcpSocket> socket, std::size_t payload_size);
 
-void read_callback(spinet::Result res, std::size_t size, std::shared_ptr<spinet::TcpSocket> socket, std::shared_ptr<uint8_t[]> buffer) {
+void read_callback(spinet::Result res, spinet::Buffer buffer, std::shared_ptr<spinet::TcpSocket> socket, std::size_t payload_size) {
     if (!res) {
         socket->close();
         return;
     }
-    socket->async_write_some(
-    buffer.get(), size, std::bind(write_callback, std::placeholders::_1, std::placeholders::_2, socket, buffer));
+    // the socket holds the buffer until the bytes are written, and then returns it to the pool
+    socket->async_write(std::move(buffer),
+    std::bind(write_callback, std::placeholders::_1, std::placeholders::_2, socket, payload_size));
 }
 
-void write_callback(spinet::Result res, std::size_t size, std::shared_ptr<spinet::TcpSocket> socket, std::shared_ptr<uint8_t[]> buffer) {
+void write_callback(spinet::Result res, std::size_t size, std::shared_ptr<spinet::TcpSocket> socket, std::size_t payload_size) {
     if (!res) {
         socket->close();
         return;
     }
     socket->async_read_some(
-    buffer.get(), size, std::bind(read_callback, std::placeholders::_1, std::placeholders::_2, socket, buffer));
+    payload_size, std::bind(read_callback, std::placeholders::_1, std::placeholders::_2, socket, payload_size));
 }
 
 int main(int argc, char* argv[]) {
@@ -58,9 +59,8 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE;
     }
     error = server.listen_tcp_endpoint(std::get<0>(address), [payload_size](std::shared_ptr<spinet::TcpSocket> socket) {
-        std::shared_ptr<uint8_t[]> buffer { new uint8_t[payload_size] };
-        socket->async_read_some(buffer.get(), payload_size,
-        std::bind(read_callback, std::placeholders::_1, std::placeholders::_2, socket, buffer));
+        socket->async_read_some(payload_size,
+        std::bind(read_callback, std::placeholders::_1, std::placeholders::_2, socket, (std::size_t)payload_size));
     });
     if (error) {
         std::cerr << error.value() << std::endl;
@@ -0,0 +1,68 @@
+#include <iostream>
+#include <vector>
+
+#include "spinet.h"
+#include "util.h"
+
+// the async echo server written as one coroutine per connection, which keeps its buffer in the frame
+spinet::Task<> echo(std::shared_ptr<spinet::TcpSocket> socket, std::size_t payload_size) {
+    std::vector<uint8_t> buffer(payload_size);
+    while (true) {
+        auto read = co_await spinet::read_some(*socket, buffer.data(), buffer.size(), std::chrono::seconds { 30 });
+        if (!read.result) {
+            break;
+        }
+        auto written = co_await spinet::write(*socket, buffer.data(), read.size);
+        if (!written.result) {
+            break;
+        }
+    }
+    socket->close();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 5) {
+        std::cerr << "Usage: PROGRAM_NAME ${address} ${port} ${worker_threads} ${payload_size}" << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto port = expectInt(argv[2], "port is an invalid number.");
+    if (port < 0 || port > 65535) {
+        std::cerr << "port should be between 0 and 65535." << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto address = spinet::Address::parse(argv[1], port);
+    if (address.index() == 1) {
+        std::cerr << std::get<1>(address) << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto worker_threads = expectInt(argv[3], "worker_threads is an invalid number.");
+    if (worker_threads <= 0) {
+        std::cerr << "worker_threads should be greater than 0." << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto payload_size = expectInt(argv[4], "payload_size is an invalid number.");
+    if (payload_size <= 0) {
+        std::cerr << "payload_size should be greater than 0." << std::endl;
+        return EXIT_FAILURE;
+    }
+    spinet::Server server {};
+    spinet::Server::Settings settings { .workers = (uint16_t)worker_threads, .reuse_port = false };
+    auto error = server.with_settings(settings);
+    if (error) {
+        std::cerr << error.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    // the accept callback runs on the runtime thread, so the frames are drawn from the pool of that runtime
+    error = server.listen_tcp_endpoint(std::get<0>(address), [payload_size](std::shared_ptr<spinet::TcpSocket> socket) {
+        spinet::spawn(echo(socket, payload_size));
+    });
+    if (error) {
+        std::cerr << error.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::thread t { [&server]() { server.run(); } };
+    std::this_thread::sleep_for(std::chrono::seconds { 60 });
+    server.stop();
+    t.join();
+    return EXIT_SUCCESS;
+}
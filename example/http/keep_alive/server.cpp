@@ -19,9 +19,8 @@ static const char RESPONSE_KEEP_ALIVE[] = "HTTP/1.1 200 OK\r\nConnection: Keep-A
 
 class HttpConnection : public std::enable_shared_from_this<HttpConnection> {
     public:
-    HttpConnection(std::shared_ptr<spinet::TcpSocket> socket, spinet::Timer& timer)
+    HttpConnection(std::shared_ptr<spinet::TcpSocket> socket)
     : socket_ { std::move(socket) }
-    , timer_ { timer }
     , header_ { new uint8_t[256] }
     , header_cap_ { 256 }
     , header_len_ { 0 }
@@ -31,8 +30,8 @@ class HttpConnection : public std::enable_shared_from_this<HttpConnection> {
         socket_->close();
     }
     void start() {
-        last_receive_time_point_ = std::chrono::steady_clock::now();
-        check_persistent_connection();
+        // the runtime closes the connection after it has been idle for 2 seconds
+        socket_->set_idle_timeout(spinet::TcpSocket::Duration { 2000 });
         receive_request_header();
     };
     bool is_closed() {
@@ -43,15 +42,6 @@ class HttpConnection : public std::enable_shared_from_this<HttpConnection> {
     }
 
     private:
-    void check_persistent_connection() {
-        if (spinet::Timer::Duration { 2000 } <= std::chrono::steady_clock::now() - last_receive_time_point_) {
-            socket_->close();
-            return;
-        }
-        auto self = shared_from_this();
-        timer_.async_wait_for(spinet::Timer::Duration { 100 },
-        [this, self](spinet::Timer::TimePoint prev, spinet::Timer::TimePoint now) { check_persistent_connection(); });
-    }
     void receive_request_header() {
         auto buf = header_.get() + header_len_;
         auto len = header_cap_ - header_len_;
@@ -61,7 +51,6 @@ class HttpConnection : public std::enable_shared_from_this<HttpConnection> {
                 socket_->close();
                 return;
             }
-            last_receive_time_point_ = std::chrono::steady_clock::now();
             set_header_length(len);
             auto header_index = index_of_header_end();
             if (header_index == header_len_) {
@@ -86,7 +75,6 @@ class HttpConnection : public std::enable_shared_from_this<HttpConnection> {
                                 socket_->close();
                                 return;
                             }
-                            last_receive_time_point_ = std::chrono::steady_clock::now();
                             send_response();
                         });
                         return;
@@ -134,7 +122,6 @@ class HttpConnection : public std::enable_shared_from_this<HttpConnection> {
         header_cap_ = header_cap_ * 2;
     }
     std::shared_ptr<spinet::TcpSocket> socket_;
-    spinet::Timer& timer_;
     std::shared_ptr<uint8_t[]> header_;
     std::size_t header_cap_;
     std::size_t header_len_;
@@ -142,7 +129,6 @@ class HttpConnection : public std::enable_shared_from_this<HttpConnection> {
     std::size_t body_len_;
     httpparser::HttpRequestParser parser_;
     httpparser::Request request_;
-    std::chrono::steady_clock::time_point last_receive_time_point_;
 };
 
 int main(int argc, char* argv[]) {
@@ -172,10 +158,8 @@ int main(int argc, char* argv[]) {
         std::cerr << error.value() << std::endl;
         return EXIT_FAILURE;
     }
-    spinet::Timer timer {};
-    timer.run();
-    error = server.listen_tcp_endpoint(std::get<0>(address), [&timer](std::shared_ptr<spinet::TcpSocket> socket) {
-        auto connection = std::make_shared<HttpConnection>(std::move(socket), timer);
+    error = server.listen_tcp_endpoint(std::get<0>(address), [](std::shared_ptr<spinet::TcpSocket> socket) {
+        auto connection = std::make_shared<HttpConnection>(std::move(socket));
         connection->start();
     });
     if (error) {
@@ -184,7 +168,6 @@ int main(int argc, char* argv[]) {
     }
     std::thread t { [&server]() { server.run(); } };
     std::this_thread::sleep_for(std::chrono::seconds { 60 });
-    timer.stop();
     server.stop();
     t.join();
     return EXIT_SUCCESS;
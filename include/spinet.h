@@ -1,10 +1,13 @@
 #pragma once
 
 #include "spinet/core/address.h"
+#include "spinet/core/buffer.h"
 #include "spinet/core/handle.h"
 #include "spinet/core/result.h"
 #include "spinet/core/tcp_socket.h"
 
 #include "spinet/client.h"
+#include "spinet/connection_pool.h"
+#include "spinet/coroutine.h"
 #include "spinet/server.h"
 #include "spinet/timer.h"
\ No newline at end of file
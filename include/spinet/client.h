@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -8,25 +9,54 @@
 #include <thread>
 #include <utility>
 #include <variant>
+#include <vector>
 
+#include "core/backend.h"
 #include "core/tcp_socket.h"
 
 namespace spinet {
 
+// how a client picks the worker of a new connection
+enum class Placement {
+    ROUND_ROBIN,
+    LEAST_CONNECTIONS, // the worker with the fewest registered sockets
+    LEAST_PENDING_BYTES, // the worker with the fewest bytes queued by the writes of its sockets
+    // the worker running the caller when it connects from a callback of this client, otherwise LEAST_CONNECTIONS
+    CURRENT_WORKER,
+};
+
 class Client {
     public:
     struct Settings {
         uint16_t workers;
         bool reuse_port;
+        std::size_t io_budget = 256 * 1024; // the bytes a socket may transfer in each direction per event
+        Backend backend = Backend::EPOLL; // the readiness mechanism of the workers
+        std::size_t zerocopy_threshold = 0; // the writes of at least this many bytes use MSG_ZEROCOPY, zero disables it
+        // serve an operation started on the runtime thread of its socket right away, and run its callback
+        // before the async call returns, see TcpSocket::set_inline_completion
+        bool inline_completion = false;
+        // the cpu set of each worker in turn, the workers are not pinned if it is empty
+        std::vector<std::vector<int>> worker_cpus = {};
+        bool numa_binding = false; // allocate the memory of a worker on the numa node of its first cpu
+        std::string thread_name = "spinet"; // the threads are named with the index of the worker appended
+        Placement placement = Placement::ROUND_ROBIN; // how the worker of a new connection is picked
         static Settings default_settings();
         std::optional<std::string> validate();
     };
 
+    // receives the connected socket, which is empty if the connect has failed
+    using ConnectCallback = std::function<void(Result, std::shared_ptr<TcpSocket>)>;
+
     Client();
     ~Client();
 
     std::optional<std::string> with_settings(Settings settings);
     std::variant<std::shared_ptr<TcpSocket>, std::string> tcp_connect(Address& address);
+    // connect without blocking the caller, the callback runs on the runtime thread of the socket. a connect which
+    // is not finished within a nonzero timeout fails with ETIMEDOUT, and one dropped by the stop with ECANCELED
+    std::optional<std::string>
+    async_tcp_connect(Address& address, TcpSocket::Duration timeout, const ConnectCallback& callback);
 
     std::optional<std::string> run();
     void stop();
@@ -41,6 +71,9 @@ class Client {
     Client& operator=(const Client& other) = delete;
 
     std::shared_ptr<spinet::Runtime>& select_runtime();
+    std::shared_ptr<spinet::Runtime>& least_loaded_runtime(std::size_t (Runtime::*load)());
+
+    void place_worker(Runtime& worker, std::size_t index);
 
     std::mutex mtx_;
     std::atomic<bool> running_;
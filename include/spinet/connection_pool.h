@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "client.h"
+#include "core/address.h"
+#include "core/tcp_socket.h"
+
+namespace spinet {
+
+// Keeps warm connections to each destination, which are spread over the workers by the placement of the client.
+// A socket is leased and returned without any lock, and a dead one is replaced by a connect in the background.
+// The idle sockets are swept periodically on the timers of a runtime, so one whose peer has hung up is replaced before
+// it is leased.
+class ConnectionPool {
+    public:
+    struct Settings {
+        std::size_t connections = 8; // the warm connections kept for each destination
+        TcpSocket::Duration connect_timeout = TcpSocket::Duration { 3000 };
+        TcpSocket::Duration retry_interval = TcpSocket::Duration { 1000 }; // the wait after a failed connect
+        // the interval of the sweeps over the idle connections, zero leaves them to be checked only when leased
+        TcpSocket::Duration idle_check_interval = TcpSocket::Duration { 1000 };
+        static Settings default_settings();
+        std::optional<std::string> validate();
+    };
+
+    class Destination;
+
+    // A leased socket, which goes back to its destination when the lease is dropped. The socket must have no
+    // pending operation by then, and it is replaced instead if it has been closed by either side.
+    class Lease {
+        public:
+        Lease();
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        // empty if no connection was idle
+        const std::shared_ptr<TcpSocket>& socket();
+        operator bool();
+        void release();
+
+        private:
+        friend class Destination;
+
+        Lease(std::shared_ptr<Destination> destination, std::size_t slot, std::shared_ptr<TcpSocket> socket);
+
+        Lease(const Lease& other) = delete;
+        Lease& operator=(const Lease& other) = delete;
+
+        std::shared_ptr<Destination> destination_;
+        std::size_t slot_;
+        std::shared_ptr<TcpSocket> socket_;
+    };
+
+    class Destination : public std::enable_shared_from_this<Destination> {
+        public:
+        ~Destination();
+
+        // take an idle connection, the lease is empty if all of them are leased or still connecting
+        Lease lease();
+        Address address();
+
+        private:
+        friend class ConnectionPool;
+        friend class Lease;
+
+        enum SlotState : uint8_t { SLOT_EMPTY, SLOT_CONNECTING, SLOT_IDLE, SLOT_LEASED };
+
+        // the socket is only touched by the owner of the current state: the connect callback while it is
+        // connecting, and the lease while it is leased
+        struct Slot {
+            std::atomic<uint8_t> state { SLOT_EMPTY };
+            std::atomic<int64_t> retry_at { 0 }; // the steady clock in milliseconds, for an empty slot
+            std::shared_ptr<TcpSocket> socket;
+        };
+
+        Destination(Client* client, const Settings& settings, const Address& address);
+
+        Destination(Destination&& other) = delete;
+        Destination& operator=(Destination&& other) = delete;
+        Destination(const Destination& other) = delete;
+        Destination& operator=(const Destination& other) = delete;
+
+        // the caller owns the slot in SLOT_CONNECTING
+        void connect(std::size_t index);
+        void give_back(std::size_t index, const std::shared_ptr<TcpSocket>& socket);
+        void fail(std::size_t index);
+        // schedule a sweep on the runtime of the socket unless one is pending already
+        void arm_sweep(const std::shared_ptr<TcpSocket>& socket);
+        void sweep();
+        // the caller owns the slot in SLOT_LEASED, whose socket is dead
+        void replace(std::size_t index);
+
+        Client* client_;
+        Settings settings_;
+        Address address_;
+        std::unique_ptr<Slot[]> slots_;
+        std::atomic<std::size_t> next_slot_; // spreads the scans of concurrent leases
+        std::atomic<bool> sweep_armed_; // at most one sweep is pending for the destination
+    };
+
+    ConnectionPool(Client& client);
+    ~ConnectionPool();
+
+    std::optional<std::string> with_settings(Settings settings);
+    // start connecting to the address in the background, the client must be running
+    std::variant<std::shared_ptr<Destination>, std::string> add_destination(Address& address);
+
+    private:
+    ConnectionPool(ConnectionPool&& other) = delete;
+    ConnectionPool& operator=(ConnectionPool&& other) = delete;
+    ConnectionPool(const ConnectionPool& other) = delete;
+    ConnectionPool& operator=(const ConnectionPool& other) = delete;
+
+    std::mutex mtx_;
+    Client* client_;
+    std::optional<Settings> settings_;
+    std::vector<std::shared_ptr<Destination>> destinations_;
+};
+
+}
\ No newline at end of file
@@ -1,14 +1,20 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <variant>
 #include <vector>
 
+#include "sys/socket.h"
+
 namespace spinet {
 
+// An ip endpoint kept in its binary form, the text is only formatted when it is asked for.
 class Address {
     public:
     enum Type { IPV4, IPV6 };
+    using ResolveCallback = std::function<void(std::variant<std::vector<Address>, std::string>)>;
 
     ~Address();
 
@@ -16,19 +22,32 @@ class Address {
     static std::variant<Address, std::string> parse(const std::string& ip, uint16_t port);
     static std::variant<std::vector<Address>, std::string> resolve(const char* domain, uint16_t port);
     static std::variant<std::vector<Address>, std::string> resolve(const std::string& domain, uint16_t port);
+    // resolve on the resolver threads, so a runtime thread is never blocked. the results are cached for a while,
+    // and the concurrent lookups of a domain share one query. the callback runs on the calling thread if the domain
+    // is cached. otherwise it is posted back to the runtime of the caller, or runs on a resolver thread if the
+    // caller is not on a runtime thread
+    static void async_resolve(const std::string& domain, uint16_t port, const ResolveCallback& callback);
+    // the family must be AF_INET or AF_INET6
+    static std::variant<Address, std::string> from_sockaddr(const ::sockaddr* address, ::socklen_t length);
 
     Type type();
     std::string address();
     uint16_t port();
 
+    // an ipv6 address is enclosed in brackets, e.g. [::1]:80
     std::string to_string();
 
+    const ::sockaddr* sockaddr();
+    ::socklen_t sockaddr_length();
+
     private:
-    Address(Type type, std::string address, uint16_t port);
+    Address(const ::sockaddr* address, ::socklen_t length);
+
+    // fill the port of the resolved addresses, which are cached without one
+    static std::variant<std::vector<Address>, std::string>
+    with_port(const std::variant<std::vector<Address>, std::string>& resolution, uint16_t port);
 
-    Type type_;
-    std::string address_;
-    uint16_t port_;
+    ::sockaddr_storage storage_;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace spinet {
+
+// the kernel interface which a runtime waits for the readiness of its handles with
+enum class Backend {
+    EPOLL,
+    // the readiness is reported by the multishot poll requests of io_uring, which batch the registrations with the
+    // waits, and the listeners are served by multishot accept requests, so a connection takes no accept syscall. the
+    // transfers still take a syscall per task as with EPOLL. it falls back to EPOLL when io_uring or its multishot
+    // poll is unavailable, and to polling a listener when multishot accept is
+    URING_POLL,
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace spinet {
+
+class Runtime;
+class SlabPool;
+class TcpSocket;
+
+// A view of a ref-counted block of memory. Copying or slicing a buffer shares the block without copying the bytes,
+// and the block is returned to its pool when the last view is dropped, on any thread.
+class Buffer {
+    public:
+    Buffer();
+    Buffer(const Buffer& other);
+    Buffer(Buffer&& other) noexcept;
+    Buffer& operator=(const Buffer& other);
+    Buffer& operator=(Buffer&& other) noexcept;
+    ~Buffer();
+
+    // allocate a buffer from the global heap, TcpSocket::allocate_buffer draws from the pool of its runtime instead
+    static Buffer allocate(std::size_t size);
+
+    uint8_t* data();
+    std::size_t size();
+    bool empty();
+    // a view of the bytes from the offset, both are clamped to this view
+    Buffer slice(std::size_t offset, std::size_t size = SIZE_MAX);
+
+    private:
+    friend class Runtime;
+    friend class TcpSocket;
+
+    struct Block;
+
+    static Buffer allocate(std::size_t size, const std::shared_ptr<SlabPool>& pool);
+
+    Buffer(Block* block, uint8_t* data, std::size_t size);
+
+    void release();
+
+    Block* block_;
+    uint8_t* data_;
+    std::size_t size_;
+};
+
+// An ordered list of buffers, which is written with one gathered write.
+class BufferChain {
+    public:
+    BufferChain();
+
+    // an empty buffer is skipped
+    void append(Buffer buffer);
+    void append(BufferChain chain);
+    void clear();
+
+    // the number of buffers
+    std::size_t count();
+    // the total bytes of all the buffers
+    std::size_t size();
+    bool empty();
+    Buffer& operator[](std::size_t index);
+    // a view of the bytes from the offset, which shares the blocks of this chain
+    BufferChain slice(std::size_t offset, std::size_t size = SIZE_MAX);
+
+    std::vector<Buffer>::iterator begin();
+    std::vector<Buffer>::iterator end();
+
+    private:
+    std::vector<Buffer> buffers_;
+    std::size_t size_;
+};
+
+}
\ No newline at end of file
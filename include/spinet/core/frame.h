@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+namespace spinet {
+
+// The frames of the coroutines started on a runtime thread are drawn from the pool of that runtime, and the others
+// from the global heap. A frame may be freed on any thread.
+void* allocate_frame(std::size_t size);
+void deallocate_frame(void* frame, std::size_t size);
+
+}
\ No newline at end of file
@@ -1,12 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 
 namespace spinet {
 
 class Runtime;
+struct RuntimeLoad;
 
-class Handle {
+class Handle : public std::enable_shared_from_this<Handle> {
     public:
     virtual ~Handle();
     virtual void close();
@@ -14,8 +16,19 @@ class Handle {
     protected:
     friend class Runtime;
 
+    // the epoll events which the handle is registered with
+    virtual uint32_t interest_events() = 0;
+    // the single entry point for the events reported by the runtime
+    virtual void on_events(uint32_t events) = 0;
+    // whether the connections of the fd may be accepted by the poller, which then reports them to on_accepted
+    virtual bool is_listener();
+    // a connection accepted by the poller, owned by the handle from now on
+    virtual void on_accepted(int fd);
+
     int fd_;
     std::weak_ptr<Runtime> runtime_;
+    // the counters of the runtime which the handle has been registered with, kept after the deregistration
+    std::shared_ptr<RuntimeLoad> load_;
 };
 
 class BaseAcceptor : public Handle {
@@ -25,7 +38,28 @@ class BaseAcceptor : public Handle {
     protected:
     friend class Runtime;
 
+    uint32_t interest_events() override;
+    void on_events(uint32_t events) override;
+    bool is_listener() override;
+    void on_accepted(int fd) override;
+
     virtual void do_accept() = 0;
+    // take over a connection which has been accepted already
+    virtual void do_accepted(int fd) = 0;
+};
+
+class BaseConnector : public Handle {
+    public:
+    virtual ~BaseConnector();
+
+    protected:
+    friend class Runtime;
+
+    uint32_t interest_events() override;
+    void on_events(uint32_t events) override;
+
+    // check the state of the pending connect, which may be called before it has finished
+    virtual void do_connect() = 0;
 };
 
 class BaseSocket : public Handle {
@@ -35,8 +69,15 @@ class BaseSocket : public Handle {
     protected:
     friend class Runtime;
 
+    uint32_t interest_events() override;
+    void on_events(uint32_t events) override;
+
     virtual void do_read() = 0;
     virtual void do_write() = 0;
+    // drain the error queue of the socket, and return false if the event carries a real error
+    virtual bool do_error() = 0;
+    // the peer has shut down its side, the bytes it sent before are still readable
+    virtual void do_hangup() = 0;
 };
 
 }
\ No newline at end of file
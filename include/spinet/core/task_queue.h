@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace spinet {
+
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// A queue with multiple producers and a single consumer, whose first elements live in a lock-free inline ring.
+// The elements which do not fit spill over to a list under a lock, so a push never fails. The ring is closed while
+// the spill holds any element, so the ring always holds the elements before the spilled ones.
+// Any thread may push, but only the owner (the runtime thread of the socket) may touch the front.
+template <typename T, std::size_t Capacity> class TaskQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    public:
+    TaskQueue()
+    : head_ { 0 }
+    , tail_ { 0 }
+    , spilled_ { 0 } {
+        for (std::size_t i = 0; i < Capacity; i++) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~TaskQueue() {
+        while (front() != nullptr) {
+            pop();
+        }
+    }
+
+    template <typename... Args> void push(Args&&... args) {
+        // once an element has spilled, the later ones follow it until the consumer drains the spill
+        if (spilled_.load(std::memory_order_acquire) == 0 && try_push(std::forward<Args>(args)...)) {
+            return;
+        }
+        std::unique_lock<std::mutex> lck { spill_mtx_ };
+        if (spill_.empty() && try_push(std::forward<Args>(args)...)) {
+            return;
+        }
+        // a producer which has read a stale spilled_ cannot claim a slot of the ring after this
+        tail_.fetch_or(RING_CLOSED, std::memory_order_acq_rel);
+        spill_.emplace_back(std::forward<Args>(args)...);
+        spilled_.store(spill_.size(), std::memory_order_release);
+    }
+
+    // consumer only, returns nullptr if the queue is empty or the next element is not published yet
+    T* front() {
+        return at(0);
+    }
+
+    // consumer only, the element at the given distance from the front
+    T* at(std::size_t index) {
+        std::size_t pos = head_ + index;
+        if (index < Capacity) {
+            Slot& slot = slots_[pos & (Capacity - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) == pos + 1) {
+                return std::launder(reinterpret_cast<T*>(slot.storage));
+            }
+        }
+        if (spilled_.load(std::memory_order_acquire) == 0) {
+            return nullptr;
+        }
+        // the spilled elements come after all of the ring, which must be published up to its tail
+        std::size_t ring_size = (tail_.load(std::memory_order_acquire) & ~RING_CLOSED) - head_;
+        if (index < ring_size || !published(ring_size)) {
+            return nullptr;
+        }
+        std::unique_lock<std::mutex> lck { spill_mtx_ };
+        if (index - ring_size >= spill_.size()) {
+            return nullptr;
+        }
+        // the spill is rarely long, the references to a list stay valid while the producers append to it
+        return &*std::next(spill_.begin(), index - ring_size);
+    }
+
+    // consumer only, the front must exist
+    void pop() {
+        // the front is spilled only if the ring is empty, and the ring stays closed until the spill is drained
+        if ((tail_.load(std::memory_order_acquire) & ~RING_CLOSED) == head_) {
+            std::unique_lock<std::mutex> lck { spill_mtx_ };
+            spill_.pop_front();
+            spilled_.store(spill_.size(), std::memory_order_release);
+            if (spill_.empty()) {
+                tail_.fetch_and(~RING_CLOSED, std::memory_order_acq_rel);
+            }
+            return;
+        }
+        Slot& slot = slots_[head_ & (Capacity - 1)];
+        std::launder(reinterpret_cast<T*>(slot.storage))->~T();
+        slot.sequence.store(head_ + Capacity, std::memory_order_release);
+        head_++;
+    }
+
+    // consumer only
+    bool empty() {
+        return front() == nullptr;
+    }
+
+    private:
+    // set in tail_ while the spill holds any element
+    static constexpr std::size_t RING_CLOSED = std::size_t { 1 } << (sizeof(std::size_t) * 8 - 1);
+
+    struct Slot {
+        std::atomic<std::size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    TaskQueue(TaskQueue&& other) = delete;
+    TaskQueue& operator=(TaskQueue&& other) = delete;
+    TaskQueue(const TaskQueue& other) = delete;
+    TaskQueue& operator=(const TaskQueue& other) = delete;
+
+    // returns false if the ring is full or closed, the arguments are not consumed then
+    template <typename... Args> bool try_push(Args&&... args) {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        Slot* slot = nullptr;
+        while (true) {
+            if (pos & RING_CLOSED) {
+                return false;
+            }
+            slot = &slots_[pos & (Capacity - 1)];
+            std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        new (slot->storage) T(std::forward<Args>(args)...);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // whether the first count elements of the ring are published
+    bool published(std::size_t count) {
+        for (std::size_t i = 0; i < count; i++) {
+            std::size_t pos = head_ + i;
+            if (slots_[pos & (Capacity - 1)].sequence.load(std::memory_order_acquire) != pos + 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the consumer and the producers write to different cache lines
+    alignas(CACHE_LINE_SIZE) std::size_t head_;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> tail_;
+    alignas(CACHE_LINE_SIZE) Slot slots_[Capacity];
+    std::atomic<std::size_t> spilled_; // the size of the spill, read without the lock
+    std::mutex spill_mtx_;
+    std::list<T> spill_;
+};
+
+}
\ No newline at end of file
@@ -1,56 +1,207 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 #include <functional>
-#include <list>
-#include <mutex>
 #include <utility>
+#include <variant>
 
 #include "address.h"
+#include "buffer.h"
 #include "handle.h"
 #include "result.h"
+#include "task_queue.h"
+#include "tcp_task.h"
+#include "timing_wheel.h"
+#include "unique_function.h"
 
 namespace spinet {
 
-class TcpReadTask;
-class TcpWriteTask;
+class TcpAcceptor;
 
 class TcpSocket : public BaseSocket {
     public:
-    using ReadCallback = std::function<void(Result, std::size_t)>;
-    using WriteCallback = std::function<void(Result, std::size_t)>;
+    // the callbacks are moved into the socket and never copied, so they may hold move-only captures
+    using ReadCallback = UniqueFunction<void(Result, std::size_t)>;
+    using WriteCallback = UniqueFunction<void(Result, std::size_t)>;
+    // receives the filled part of the buffer read by the socket
+    using BufferReadCallback = UniqueFunction<void(Result, Buffer)>;
+
+    // the pending tasks kept inline in each direction, the later ones spill over to the heap. the async operations
+    // only return false if the socket is closed
+    static constexpr std::size_t TASK_QUEUE_CAPACITY = 4;
 
     TcpSocket(int fd, const Address& peer);
     ~TcpSocket();
 
-    bool async_read(uint8_t* buf, std::size_t size, const ReadCallback& callback);
-    bool async_read_some(uint8_t* buf, std::size_t size, const ReadCallback& callback);
-    bool async_write(uint8_t* buf, std::size_t size, const WriteCallback& callback);
-    bool async_write_some(uint8_t* buf, std::size_t size, const WriteCallback& callback);
+    using Duration = TimerScheduler::Duration;
+
+    // an operation which is not finished within a nonzero timeout completes with ETIMEDOUT,
+    // the timeout starts when the operation is queued. it covers the transfer only, a zerocopy write whose bytes are
+    // all sent waits for the kernel to release its buffer without a deadline, and the writes queued behind it wait too.
+    // a zerocopy write which fails or times out after a partial send completes once its bytes are released as well
+    bool async_read(uint8_t* buf, std::size_t size, ReadCallback callback, Duration timeout = {});
+    bool async_read_some(uint8_t* buf, std::size_t size, ReadCallback callback, Duration timeout = {});
+    bool async_write(uint8_t* buf, std::size_t size, WriteCallback callback, Duration timeout = {});
+    bool async_write_some(uint8_t* buf, std::size_t size, WriteCallback callback, Duration timeout = {});
+    // fill all the buffers in order, the callback receives the total size
+    bool async_readv(const ::iovec* iov, std::size_t count, ReadCallback callback, Duration timeout = {});
+    // write all the buffers in order with as few syscalls as possible, the callback receives the total size
+    bool async_writev(const ::iovec* iov, std::size_t count, WriteCallback callback, Duration timeout = {});
+    // read into a buffer drawn from the pool of the runtime, the callback takes the ownership of it
+    bool async_read(std::size_t size, BufferReadCallback callback, Duration timeout = {});
+    bool async_read_some(std::size_t size, BufferReadCallback callback, Duration timeout = {});
+    // the runtime lends a buffer of up to 16 KiB only when the bytes arrive, so a waiting read holds no memory.
+    // a read of up to 4 KiB is copied into a buffer of its size, so it does not pin the lent one
+    bool async_read_some(BufferReadCallback callback, Duration timeout = {});
+    // the socket holds the buffers until the callback, so the caller need not keep them alive
+    bool async_write(Buffer buffer, WriteCallback callback, Duration timeout = {});
+    bool async_write(BufferChain chain, WriteCallback callback, Duration timeout = {});
+    // a buffer from the pool of the runtime, or from the global heap if the socket is not registered
+    Buffer allocate_buffer(std::size_t size);
+    // send the bytes of a file from the offset without copying them into the user space, the file must stay open
+    // until the callback. the callback receives fewer bytes than the size if the file ends earlier
+    bool async_sendfile(int file_fd, off_t offset, std::size_t size, WriteCallback callback, Duration timeout = {});
+    // move the bytes held by a pipe into the socket without copying them into the user space, the pipe must stay
+    // open until the callback. the callback receives fewer bytes than the size if the pipe is closed by its writer
+    bool async_splice(int pipe_fd, std::size_t size, WriteCallback callback, Duration timeout = {});
+
+    // limit the bytes transferred in each direction per readiness event, so that one busy socket cannot starve others
+    void set_io_budget(std::size_t bytes);
+    // send the writes of at least this many bytes with MSG_ZEROCOPY, zero disables it. the callback of such a write
+    // runs after the kernel releases the buffer, and the later writes complete after it to keep the order. it falls
+    // back to the normal send if the socket does not support it, or the kernel has to copy the bytes anyway. the
+    // timeout of such a write does not cover the wait for the release, the idle timeout or closing the socket ends it.
+    // closing the socket before the kernel has released every zerocopy send resets the connection, so that the kernel
+    // drops the pinned pages and the pending writes complete with the error right away
+    void set_zerocopy_threshold(std::size_t bytes);
+    // close the socket after no byte has been transferred for the timeout, and complete the pending operations
+    // with ETIMEDOUT. zero disables it
+    void set_idle_timeout(Duration timeout);
+    // serve an operation started on the runtime thread of the socket while none is pending in its direction right
+    // away, so it may finish and run its callback before the async call returns. the caller must be ready for the
+    // reentrancy. otherwise the operation is served on the current iteration of the runtime, which is the default
+    void set_inline_completion(bool enabled);
+
+    // run the callback on the runtime thread of this socket, the handle is empty if the socket is not registered
+    TimerHandle async_wait_for(TimerScheduler::Duration duration, const TimerScheduler::Callback& callback);
+    TimerHandle async_wait_until(TimerScheduler::TimePoint time_point, const TimerScheduler::Callback& callback);
 
     void cancel();
     bool is_closed();
+    // the peer has shut down or reset the connection, so the socket cannot be reused for another request
+    bool is_peer_closed();
     void close() override;
     Address peer();
 
     private:
+    friend class TcpAcceptor;
+
+    using ReadCompletion = std::variant<ReadCallback, BufferReadCallback>;
+    using ReadTaskQueue = TaskQueue<std::pair<TcpReadTask, ReadCompletion>, TASK_QUEUE_CAPACITY>;
+    using WriteTaskQueue = TaskQueue<std::pair<TcpWriteTask, WriteCallback>, TASK_QUEUE_CAPACITY>;
+
     TcpSocket(TcpSocket&& other) = delete;
     TcpSocket& operator=(TcpSocket&& other) = delete;
     TcpSocket(const TcpSocket& other) = delete;
     TcpSocket& operator=(const TcpSocket& other) = delete;
 
+    // an intrusive timer of the socket, which is only scheduled on the runtime thread
+    class DeadlineTimer : public TimerNode {
+        public:
+        DeadlineTimer(TcpSocket* socket, void (TcpSocket::*handler)());
+
+        TimePoint armed_; // max if it is not armed
+
+        protected:
+        void on_expired(TimePoint time_point, TimePoint now) override;
+
+        private:
+        TcpSocket* socket_;
+        void (TcpSocket::*handler_)();
+    };
+
+    enum ZerocopyState { ZEROCOPY_UNKNOWN, ZEROCOPY_ON, ZEROCOPY_OFF, ZEROCOPY_UNSUPPORTED };
+
+    // a write whose buffer may still be pinned by the kernel
+    struct ZerocopyCompletion {
+        uint32_t id; // the id of the last zerocopy send before it
+        std::size_t size;
+        Result result;
+        WriteCallback callback;
+        // the buffers owned by a zerocopy write, kept alive until the kernel releases them
+        BufferChain chain;
+        Buffer buffer;
+    };
+
+    template <typename Queue, typename Task, typename Callback>
+    bool submit(Queue& queue, Task&& task, Callback&& callback, Duration timeout);
+    // account the bytes of a write in the load of the runtime until it is completed
+    void charge(TcpReadTask& task);
+    void charge(TcpWriteTask& task);
+    void discharge(std::size_t bytes);
+    void schedule();
+    // serve the direction at once if its queue holds only the task just pushed, and this is the runtime thread
+    template <typename Queue> bool serve_inline(Queue& queue, void (TcpSocket::*action)());
+    void run_in_runtime(void (TcpSocket::*action)());
+    void close_with(int ec);
+    void release_tasks(int ec);
+    void discard_tasks();
     void do_read() override;
     void do_write() override;
+    bool do_error() override;
+    void do_hangup() override;
+    std::size_t read_tasks();
+    std::size_t write_tasks();
+    template <typename Queue> void arm_deadline(Queue& queue, DeadlineTimer& timer);
+    void arm_timer(DeadlineTimer& timer, TimerScheduler::TimePoint time_point);
+    void disarm_timer(DeadlineTimer& timer);
+    void arm_idle_timer();
+    void track_activity(std::size_t transferred);
+    void cancel_timers(const std::shared_ptr<TimerScheduler>& timers);
+    void on_read_deadline();
+    void on_write_deadline();
+    void on_idle_deadline();
+    bool use_zerocopy(TcpWriteTask& task);
+    void finish_read(Result res);
+    void finish_write(Result res);
+    void complete_zerocopy(uint32_t id);
+    // serve the writes again when the drained pipe of the front splice becomes readable
+    void watch_pipe(int pipe_fd);
+    void unwatch_pipe();
 
     std::atomic<bool> closed_;
+    std::atomic<bool> peer_closed_;
+    std::atomic<uint32_t> producers_; // the threads which are pushing tasks right now
+    std::atomic<std::size_t> io_budget_;
+    std::atomic<bool> inline_completion_;
+    uint64_t queue_epoch_; // increased whenever the queued tasks are dropped, only touched by the runtime thread
+    // a direction being served leaves a new task to the runtime, only touched by the runtime thread
+    bool reading_;
+    bool writing_;
+
+    // the deadlines are tracked by the timing wheel of the runtime, and only touched by the runtime thread
+    std::weak_ptr<TimerScheduler> timers_;
+    std::atomic<Duration::rep> idle_timeout_;
+    TimerScheduler::TimePoint last_active_;
+    DeadlineTimer read_deadline_timer_;
+    DeadlineTimer write_deadline_timer_;
+    DeadlineTimer idle_timer_;
 
-    std::mutex read_mtx_;
-    std::list<std::pair<TcpReadTask, ReadCallback>> read_task_queue_;
+    // the zerocopy state is only touched by the runtime thread, the ids are also read by a closing thread
+    std::atomic<std::size_t> zerocopy_threshold_;
+    ZerocopyState zerocopy_state_;
+    std::atomic<uint32_t> zerocopy_next_id_; // the kernel numbers the zerocopy sends of a socket from zero
+    std::atomic<uint32_t> zerocopy_released_id_; // the id following the last send released by the kernel
+    std::deque<ZerocopyCompletion> zerocopy_completions_;
+    std::shared_ptr<Handle> pipe_watcher_; // only touched by the runtime thread
 
-    std::mutex write_mtx_;
-    std::list<std::pair<TcpWriteTask, WriteCallback>> write_task_queue_;
+    ReadTaskQueue read_task_queue_;
+    WriteTaskQueue write_task_queue_;
 
     Address peer_;
+    // the load which counts the socket as an accepted connection until it is closed, null if it was not accepted
+    std::shared_ptr<RuntimeLoad> connection_load_;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,503 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "errno.h"
+#include "fcntl.h"
+#include "limits.h"
+#include "sys/sendfile.h"
+#include "sys/socket.h"
+#include "sys/uio.h"
+
+#include "buffer.h"
+
+namespace spinet {
+
+enum TaskStrategy { TRY, UNTIL_FINISHED };
+
+using TaskDeadline = std::chrono::steady_clock::time_point;
+
+// The buffers of a task, which are advanced in place as the bytes are transferred.
+class IoVector {
+    public:
+    // the iovecs up to this count are stored without allocation
+    static constexpr std::size_t INLINE_CAPACITY = 3;
+
+    IoVector(uint8_t* buf, std::size_t size)
+    : count_ { 1 }
+    , index_ { 0 } {
+        inline_[0] = { buf, size };
+        skip_empty();
+    }
+
+    IoVector(const ::iovec* iov, std::size_t count)
+    : count_ { count }
+    , index_ { 0 } {
+        ::iovec* dst = inline_;
+        if (count > INLINE_CAPACITY) {
+            heap_.reset(new ::iovec[count]);
+            dst = heap_.get();
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            dst[i] = iov[i];
+        }
+        skip_empty();
+    }
+
+    IoVector(BufferChain& chain)
+    : count_ { chain.count() }
+    , index_ { 0 } {
+        ::iovec* dst = inline_;
+        if (count_ > INLINE_CAPACITY) {
+            heap_.reset(new ::iovec[count_]);
+            dst = heap_.get();
+        }
+        for (std::size_t i = 0; i < count_; i++) {
+            dst[i] = { chain[i].data(), chain[i].size() };
+        }
+        skip_empty();
+    }
+
+    IoVector(IoVector&& other) = default;
+    IoVector& operator=(IoVector&& other) = default;
+
+    // the remaining buffers
+    ::iovec* data() {
+        return (heap_ ? heap_.get() : inline_) + index_;
+    }
+
+    std::size_t count() {
+        return count_ - index_;
+    }
+
+    // the remaining bytes
+    std::size_t size() {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < count(); i++) {
+            total = total + data()[i].iov_len;
+        }
+        return total;
+    }
+
+    // advance the buffers and return how many of the bytes belong to them
+    std::size_t consume(std::size_t bytes) {
+        std::size_t consumed = 0;
+        ::iovec* iov = heap_ ? heap_.get() : inline_;
+        while (index_ < count_ && consumed < bytes) {
+            std::size_t len = std::min(iov[index_].iov_len, bytes - consumed);
+            iov[index_].iov_base = static_cast<uint8_t*>(iov[index_].iov_base) + len;
+            iov[index_].iov_len = iov[index_].iov_len - len;
+            consumed = consumed + len;
+            skip_empty();
+        }
+        return consumed;
+    }
+
+    private:
+    void skip_empty() {
+        ::iovec* iov = heap_ ? heap_.get() : inline_;
+        while (index_ < count_ && iov[index_].iov_len == 0) {
+            index_++;
+        }
+    }
+
+    ::iovec inline_[INLINE_CAPACITY];
+    std::unique_ptr<::iovec[]> heap_;
+    std::size_t count_;
+    std::size_t index_;
+};
+
+class TcpReadTask {
+    public:
+    TcpReadTask(uint8_t* buf, std::size_t size, spinet::TaskStrategy strategy)
+    : finished_ { size == 0 }
+    , buffers_ { buf, size }
+    , pos_ { 0 }
+    , strategy_ { strategy }
+    , deadline_ { TaskDeadline::max() }
+    , owned_ {}
+    , provided_ { false } {
+    }
+
+    TcpReadTask(const ::iovec* iov, std::size_t count, spinet::TaskStrategy strategy)
+    : finished_ { false }
+    , buffers_ { iov, count }
+    , pos_ { 0 }
+    , strategy_ { strategy }
+    , deadline_ { TaskDeadline::max() }
+    , owned_ {}
+    , provided_ { false } {
+        finished_ = buffers_.count() == 0;
+    }
+
+    // the task owns the buffer, which is handed back filled by take_buffer
+    TcpReadTask(Buffer buffer, spinet::TaskStrategy strategy)
+    : finished_ { buffer.empty() }
+    , buffers_ { buffer.data(), buffer.size() }
+    , pos_ { 0 }
+    , strategy_ { strategy }
+    , deadline_ { TaskDeadline::max() }
+    , owned_ { std::move(buffer) }
+    , provided_ { false } {
+    }
+
+    // the runtime provides the buffer only when the bytes arrive, see wants_buffer
+    explicit TcpReadTask(spinet::TaskStrategy strategy)
+    : finished_ { false }
+    , buffers_ { static_cast<uint8_t*>(nullptr), 0 }
+    , pos_ { 0 }
+    , strategy_ { strategy }
+    , deadline_ { TaskDeadline::max() }
+    , owned_ {}
+    , provided_ { true } {
+    }
+
+    std::optional<int> exec(int fd) {
+        if (finished_) {
+            return {};
+        }
+        ssize_t bytes {};
+        if (buffers_.count() == 1) {
+            ::iovec* iov = buffers_.data();
+            bytes = ::recv(fd, iov->iov_base, iov->iov_len, MSG_NOSIGNAL);
+        } else {
+            ::msghdr msg {};
+            msg.msg_iov = buffers_.data();
+            msg.msg_iovlen = std::min<std::size_t>(buffers_.count(), IOV_MAX);
+            bytes = ::recvmsg(fd, &msg, MSG_NOSIGNAL);
+        }
+        if (bytes <= 0) {
+            if (bytes == 0) {
+                return EBADF;
+            } else {
+                return errno;
+            }
+        }
+        pos_ = pos_ + buffers_.consume(bytes);
+        if (strategy_ == TaskStrategy::TRY) {
+            finished_ = true;
+        } else { // the alternative is UNTIL_FINISHED
+            if (buffers_.count() == 0) {
+                finished_ = true;
+            }
+        }
+        return {};
+    }
+
+    bool finished() {
+        return finished_;
+    }
+
+    std::size_t finished_size() {
+        return pos_;
+    }
+
+    // the task fails with ETIMEDOUT if it is not finished by the deadline
+    void set_deadline(TaskDeadline deadline) {
+        deadline_ = deadline;
+    }
+
+    TaskDeadline deadline() {
+        return deadline_;
+    }
+
+    // the buffer of a provided task is lent by the runtime right before each read
+    bool wants_buffer() {
+        return provided_ && owned_.empty() && !finished_;
+    }
+
+    void provide(Buffer buffer) {
+        buffers_ = IoVector { buffer.data(), buffer.size() };
+        owned_ = std::move(buffer);
+    }
+
+    // give back the lent buffer if it has received no byte, so the idle task holds no memory
+    Buffer reclaim() {
+        if (!provided_ || pos_ > 0) {
+            return {};
+        }
+        buffers_ = IoVector { static_cast<uint8_t*>(nullptr), 0 };
+        return std::move(owned_);
+    }
+
+    bool is_provided() {
+        return provided_;
+    }
+
+    // the whole owned buffer, whose filled part is the finished size
+    Buffer take_whole_buffer() {
+        return std::move(owned_);
+    }
+
+    // the filled part of the owned buffer, empty if the task does not own one
+    Buffer take_buffer() {
+        auto buffer = pos_ > 0 ? owned_.slice(0, pos_) : Buffer {};
+        owned_ = {};
+        return buffer;
+    }
+
+    private:
+    bool finished_;
+    IoVector buffers_;
+    std::size_t pos_;
+    spinet::TaskStrategy strategy_;
+    TaskDeadline deadline_;
+    Buffer owned_;
+    bool provided_;
+};
+
+// where the bytes of a write task come from
+enum WriteSource { BUFFERS, FILE, PIPE };
+
+class TcpWriteTask {
+    public:
+    TcpWriteTask(uint8_t* buf, std::size_t size, spinet::TaskStrategy strategy)
+    : finished_ { size == 0 }
+    , buffers_ { buf, size }
+    , pos_ { 0 }
+    , strategy_ { strategy }
+    , deadline_ { TaskDeadline::max() }
+    , source_ { WriteSource::BUFFERS }
+    , source_fd_ { -1 }
+    , offset_ { 0 }
+    , remaining_ { 0 }
+    , zerocopy_ { false }
+    , zerocopy_id_ { 0 }
+    , charged_ { 0 } {
+    }
+
+    TcpWriteTask(const ::iovec* iov, std::size_t count, spinet::TaskStrategy strategy)
+    : finished_ { false }
+    , buffers_ { iov, count }
+    , pos_ { 0 }
+    , strategy_ { strategy }
+    , deadline_ { TaskDeadline::max() }
+    , source_ { WriteSource::BUFFERS }
+    , source_fd_ { -1 }
+    , offset_ { 0 }
+    , remaining_ { 0 }
+    , zerocopy_ { false }
+    , zerocopy_id_ { 0 }
+    , charged_ { 0 } {
+        finished_ = buffers_.count() == 0;
+    }
+
+    // the task owns the buffer until it is completed, without the allocation of a chain
+    TcpWriteTask(Buffer buffer, spinet::TaskStrategy strategy)
+    : finished_ { buffer.empty() }
+    , buffers_ { buffer.data(), buffer.size() }
+    , pos_ { 0 }
+    , strategy_ { strategy }
+    , deadline_ { TaskDeadline::max() }
+    , source_ { WriteSource::BUFFERS }
+    , source_fd_ { -1 }
+    , offset_ { 0 }
+    , remaining_ { 0 }
+    , zerocopy_ { false }
+    , zerocopy_id_ { 0 }
+    , charged_ { 0 }
+    , owned_ {}
+    , owned_buffer_ { std::move(buffer) } {
+    }
+
+    // the task owns the buffers until it is completed
+    TcpWriteTask(BufferChain chain, spinet::TaskStrategy strategy)
+    : finished_ { chain.empty() }
+    , buffers_ { chain }
+    , pos_ { 0 }
+    , strategy_ { strategy }
+    , deadline_ { TaskDeadline::max() }
+    , source_ { WriteSource::BUFFERS }
+    , source_fd_ { -1 }
+    , offset_ { 0 }
+    , remaining_ { 0 }
+    , zerocopy_ { false }
+    , zerocopy_id_ { 0 }
+    , charged_ { 0 }
+    , owned_ { std::move(chain) } {
+    }
+
+    // the bytes are moved by the kernel from a file (with sendfile) or a pipe (with splice),
+    // the offset is ignored for a pipe
+    TcpWriteTask(WriteSource source, int source_fd, off_t offset, std::size_t size)
+    : finished_ { size == 0 }
+    , buffers_ { static_cast<uint8_t*>(nullptr), 0 }
+    , pos_ { 0 }
+    , strategy_ { TaskStrategy::UNTIL_FINISHED }
+    , deadline_ { TaskDeadline::max() }
+    , source_ { source }
+    , source_fd_ { source_fd }
+    , offset_ { offset }
+    , remaining_ { size }
+    , zerocopy_ { false }
+    , zerocopy_id_ { 0 }
+    , charged_ { 0 } {
+    }
+
+    std::optional<int> exec(int fd) {
+        if (finished_) {
+            return {};
+        }
+        if (source_ != WriteSource::BUFFERS) {
+            return transfer(fd);
+        }
+        ssize_t bytes {};
+        if (buffers_.count() == 1) {
+            ::iovec* iov = buffers_.data();
+            bytes = ::send(fd, iov->iov_base, iov->iov_len, MSG_NOSIGNAL);
+        } else {
+            ::msghdr msg {};
+            msg.msg_iov = buffers_.data();
+            msg.msg_iovlen = std::min<std::size_t>(buffers_.count(), IOV_MAX);
+            bytes = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        }
+        if (bytes <= 0) {
+            if (bytes == 0) {
+                return EBADF;
+            } else {
+                return errno;
+            }
+        }
+        advance(bytes);
+        return {};
+    }
+
+    // the bytes of a buffered task can be gathered with the neighbouring tasks into one write
+    bool is_buffered() {
+        return source_ == WriteSource::BUFFERS;
+    }
+
+    // the pipe of a splice, which may run dry while the socket is still writable
+    bool is_piped() {
+        return source_ == WriteSource::PIPE;
+    }
+
+    int source_fd() {
+        return source_fd_;
+    }
+
+    // the bytes left to write
+    std::size_t remaining_size() {
+        return source_ == WriteSource::BUFFERS ? buffers_.size() : remaining_;
+    }
+
+    // append the remaining buffers to iov for a gathered write, and return how many are appended
+    std::size_t gather(::iovec* iov, std::size_t capacity) {
+        if (finished_ || source_ != WriteSource::BUFFERS) {
+            return 0;
+        }
+        std::size_t count = std::min(buffers_.count(), capacity);
+        std::copy(buffers_.data(), buffers_.data() + count, iov);
+        return count;
+    }
+
+    // account the bytes written by a gathered write, and return how many of them belong to this task
+    std::size_t advance(std::size_t bytes) {
+        std::size_t consumed = buffers_.consume(bytes);
+        pos_ = pos_ + consumed;
+        if (strategy_ == TaskStrategy::TRY) {
+            if (consumed > 0) {
+                finished_ = true;
+            }
+        } else { // the alternative is UNTIL_FINISHED
+            if (buffers_.count() == 0) {
+                finished_ = true;
+            }
+        }
+        return consumed;
+    }
+
+    bool finished() {
+        return finished_;
+    }
+
+    std::size_t finished_size() {
+        return pos_;
+    }
+
+    // the task fails with ETIMEDOUT if it is not finished by the deadline
+    void set_deadline(TaskDeadline deadline) {
+        deadline_ = deadline;
+    }
+
+    TaskDeadline deadline() {
+        return deadline_;
+    }
+
+    // the buffers are pinned by the kernel until the notification of the last zerocopy send is received
+    void set_zerocopy_id(uint32_t id) {
+        zerocopy_ = true;
+        zerocopy_id_ = id;
+    }
+
+    bool is_zerocopy() {
+        return zerocopy_;
+    }
+
+    uint32_t zerocopy_id() {
+        return zerocopy_id_;
+    }
+
+    // hand over the owned buffers, which must outlive the task while the kernel pins them for a zerocopy send
+    BufferChain take_chain() {
+        return std::move(owned_);
+    }
+
+    Buffer take_buffer() {
+        return std::move(owned_buffer_);
+    }
+
+    // the bytes added to the pending bytes of the runtime when the task was queued
+    void set_charged(std::size_t bytes) {
+        charged_ = bytes;
+    }
+
+    std::size_t charged() {
+        return charged_;
+    }
+
+    private:
+    std::optional<int> transfer(int fd) {
+        ssize_t bytes {};
+        if (source_ == WriteSource::FILE) {
+            bytes = ::sendfile(fd, source_fd_, &offset_, remaining_);
+        } else { // the alternative is PIPE
+            // an empty pipe fails with EAGAIN rather than blocking the runtime thread
+            bytes = ::splice(source_fd_, nullptr, fd, nullptr, remaining_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        }
+        if (bytes < 0) {
+            return errno;
+        }
+        if (bytes == 0) {
+            // the file or the pipe has ended before the size, the callback receives the bytes sent so far
+            finished_ = true;
+            return {};
+        }
+        pos_ = pos_ + bytes;
+        remaining_ = remaining_ - bytes;
+        finished_ = remaining_ == 0;
+        return {};
+    }
+
+    bool finished_;
+    IoVector buffers_;
+    std::size_t pos_;
+    spinet::TaskStrategy strategy_;
+    TaskDeadline deadline_;
+    WriteSource source_;
+    int source_fd_;
+    off_t offset_;
+    std::size_t remaining_;
+    bool zerocopy_;
+    uint32_t zerocopy_id_;
+    std::size_t charged_;
+    BufferChain owned_;
+    Buffer owned_buffer_;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace spinet {
+
+class TimingWheel;
+class TimerScheduler;
+class CallbackTimer;
+
+// An intrusive entry of a timing wheel, which is linked and unlinked without any allocation.
+// A node must be cancelled before it is destroyed, the cancellation waits for an expiry in flight on another thread.
+class TimerNode {
+    public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = std::chrono::time_point<Clock>;
+
+    TimerNode();
+    virtual ~TimerNode();
+
+    protected:
+    // called without the lock of the scheduler, after the node is unlinked
+    virtual void on_expired(TimePoint time_point, TimePoint now) = 0;
+    // called when the scheduler drops the node without firing it
+    virtual void on_dropped();
+
+    private:
+    friend class TimingWheel;
+    friend class TimerScheduler;
+
+    TimerNode(TimerNode&& other) = delete;
+    TimerNode& operator=(TimerNode&& other) = delete;
+    TimerNode(const TimerNode& other) = delete;
+    TimerNode& operator=(const TimerNode& other) = delete;
+
+    TimerNode** list_; // the list head of the slot holding this node, nullptr if it is not scheduled
+    TimerNode* prev_;
+    TimerNode* next_;
+    uint64_t expiry_; // in ticks since the origin of the wheel
+    TimePoint time_point_;
+};
+
+// A hierarchical timing wheel with a tick of one millisecond. Scheduling and cancelling are O(1),
+// and a node is cascaded at most once per level on its way to the lowest level. It is not thread safe.
+class TimingWheel {
+    public:
+    using Clock = TimerNode::Clock;
+    using TimePoint = TimerNode::TimePoint;
+    using Tick = std::chrono::milliseconds;
+
+    static constexpr std::size_t SLOT_BITS = 6;
+    static constexpr std::size_t SLOTS = 1 << SLOT_BITS;
+    // the levels span 2^24 ticks (about 4.6 hours), the later nodes wait in an overflow list
+    static constexpr std::size_t LEVELS = 4;
+
+    explicit TimingWheel(TimePoint origin);
+    ~TimingWheel();
+
+    // reschedule the node if it has been scheduled, a node never expires earlier than the time point
+    void schedule(TimerNode* node, TimePoint time_point);
+    void cancel(TimerNode* node);
+    bool is_scheduled(TimerNode* node);
+    // move the nodes expired by now to the expired list
+    void advance(TimePoint now);
+    TimerNode* pop_expired();
+    // remove and return any node, nullptr if the wheel is empty
+    TimerNode* pop_any();
+    // the earliest time point the wheel has to be advanced at
+    std::optional<TimePoint> next_expiry();
+
+    private:
+    TimingWheel(TimingWheel&& other) = delete;
+    TimingWheel& operator=(TimingWheel&& other) = delete;
+    TimingWheel(const TimingWheel& other) = delete;
+    TimingWheel& operator=(const TimingWheel& other) = delete;
+
+    uint64_t to_tick(TimePoint time_point, bool round_up);
+    uint64_t next_tick();
+    void place(TimerNode* node);
+    void link(TimerNode** list, TimerNode* node);
+    void unlink(TimerNode* node);
+    void cascade(TimerNode** list);
+
+    TimePoint origin_;
+    uint64_t current_; // the last processed tick
+    TimerNode* slots_[LEVELS][SLOTS];
+    uint64_t occupied_[LEVELS]; // a bitmap of the non-empty slots on each level
+    TimerNode* overflow_;
+    TimerNode* expired_;
+};
+
+// A handle of a scheduled callback, which can be copied freely and cancels the callback from any thread.
+class TimerHandle {
+    public:
+    TimerHandle();
+    ~TimerHandle();
+
+    // the callback will not be called after cancel returns, unless it has started already on the calling thread
+    void cancel();
+    bool is_pending();
+
+    private:
+    friend class TimerScheduler;
+
+    explicit TimerHandle(const std::shared_ptr<CallbackTimer>& timer);
+
+    std::weak_ptr<CallbackTimer> timer_;
+};
+
+// A thread safe timing wheel. The expired callbacks run on the thread calling expire, without the lock held.
+class TimerScheduler : public std::enable_shared_from_this<TimerScheduler> {
+    public:
+    using Clock = TimingWheel::Clock;
+    using TimePoint = TimingWheel::TimePoint;
+    using Duration = std::chrono::milliseconds;
+    using Callback = std::function<void(TimePoint, TimePoint)>;
+
+    // on_earlier is called when a newly scheduled node moves the next expiry forward
+    explicit TimerScheduler(std::function<void()> on_earlier = {});
+    ~TimerScheduler();
+
+    TimerHandle schedule(TimePoint time_point, const Callback& callback);
+    void schedule(TimerNode* node, TimePoint time_point);
+    // once it returns the node is neither scheduled nor being fired by another thread, so it may be destroyed
+    void cancel(TimerNode* node);
+    std::optional<TimePoint> next_expiry();
+    void expire(TimePoint now);
+    // drop all the scheduled nodes without firing them
+    void clear();
+
+    private:
+    friend class TimerHandle;
+
+    TimerScheduler(TimerScheduler&& other) = delete;
+    TimerScheduler& operator=(TimerScheduler&& other) = delete;
+    TimerScheduler(const TimerScheduler& other) = delete;
+    TimerScheduler& operator=(const TimerScheduler& other) = delete;
+
+    std::mutex mtx_;
+    TimingWheel wheel_;
+    std::function<void()> on_earlier_;
+    // the node whose on_expired is running, it is unlinked already, so cancel has to wait on fired_cv_ for it
+    TimerNode* firing_;
+    std::thread::id firing_thread_id_;
+    std::condition_variable fired_cv_;
+};
+
+}
\ No newline at end of file
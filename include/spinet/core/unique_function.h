@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace spinet {
+
+template <typename Signature> class UniqueFunction;
+
+// A move-only callable wrapper. Unlike std::function it never copies the callable, and the captures of a typical
+// completion (two shared_ptrs and a pointer) are stored inline, so queuing a callback does not touch the heap.
+template <typename R, typename... Args> class UniqueFunction<R(Args...)> {
+    public:
+    static constexpr std::size_t INLINE_SIZE = 2 * sizeof(std::shared_ptr<void>) + sizeof(void*);
+
+    UniqueFunction() noexcept
+    : ops_ { nullptr } {
+    }
+
+    UniqueFunction(std::nullptr_t) noexcept
+    : ops_ { nullptr } {
+    }
+
+    template <typename F,
+    typename Callable = std::decay_t<F>,
+    typename = std::enable_if_t<!std::is_same_v<Callable, UniqueFunction> && std::is_invocable_r_v<R, Callable&, Args...>>>
+    UniqueFunction(F&& f)
+    : ops_ { nullptr } {
+        if constexpr (std::is_constructible_v<bool, const Callable&>) {
+            // an empty std::function or a null pointer stays empty
+            if (!static_cast<bool>(f)) {
+                return;
+            }
+        }
+        if constexpr (fits_inline<Callable>()) {
+            new (storage_) Callable(std::forward<F>(f));
+        } else {
+            new (storage_) Callable*(new Callable(std::forward<F>(f)));
+        }
+        ops_ = &OPS<Callable>;
+    }
+
+    UniqueFunction(UniqueFunction&& other) noexcept
+    : ops_ { other.ops_ } {
+        if (ops_ != nullptr) {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    UniqueFunction& operator=(UniqueFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops_ != nullptr) {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = std::exchange(other.ops_, nullptr);
+            }
+        }
+        return *this;
+    }
+
+    UniqueFunction& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    ~UniqueFunction() {
+        reset();
+    }
+
+    // like std::function, calling an empty one throws std::bad_function_call
+    R operator()(Args... args) const {
+        if (ops_ == nullptr) {
+            throw std::bad_function_call {};
+        }
+        return ops_->invoke(storage_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept {
+        return ops_ != nullptr;
+    }
+
+    private:
+    struct Ops {
+        R (*invoke)(void* storage, Args&&... args);
+        // move the callable into the uninitialized dst, and destroy the one left in src
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <typename Callable> static constexpr bool fits_inline() {
+        return sizeof(Callable) <= INLINE_SIZE && alignof(Callable) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible_v<Callable>;
+    }
+
+    template <typename Callable> static Callable& target(void* storage) {
+        if constexpr (fits_inline<Callable>()) {
+            return *std::launder(reinterpret_cast<Callable*>(storage));
+        } else {
+            return **std::launder(reinterpret_cast<Callable**>(storage));
+        }
+    }
+
+    template <typename Callable> static constexpr Ops OPS = {
+        [](void* storage, Args&&... args) -> R {
+            return std::invoke(target<Callable>(storage), std::forward<Args>(args)...);
+        },
+        [](void* dst, void* src) noexcept {
+            if constexpr (fits_inline<Callable>()) {
+                auto callable = std::launder(reinterpret_cast<Callable*>(src));
+                new (dst) Callable(std::move(*callable));
+                callable->~Callable();
+            } else {
+                new (dst) Callable*(*std::launder(reinterpret_cast<Callable**>(src)));
+            }
+        },
+        [](void* storage) noexcept {
+            if constexpr (fits_inline<Callable>()) {
+                std::launder(reinterpret_cast<Callable*>(storage))->~Callable();
+            } else {
+                delete *std::launder(reinterpret_cast<Callable**>(storage));
+            }
+        },
+    };
+
+    UniqueFunction(const UniqueFunction& other) = delete;
+    UniqueFunction& operator=(const UniqueFunction& other) = delete;
+
+    void reset() noexcept {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) mutable unsigned char storage_[INLINE_SIZE];
+    const Ops* ops_;
+};
+
+}
\ No newline at end of file
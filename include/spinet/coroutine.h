@@ -0,0 +1,331 @@
+#pragma once
+
+// The awaitable api needs the coroutines of C++20, the rest of the library is built as C++17.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "core/frame.h"
+#include "core/result.h"
+#include "core/tcp_socket.h"
+#include "timer.h"
+
+namespace spinet {
+
+template <typename T = void> class Task;
+
+namespace detail {
+
+    // the frames are drawn from the pool of the runtime which starts the coroutine
+    struct PromiseBase {
+        static void* operator new(std::size_t size) {
+            return allocate_frame(size);
+        }
+
+        static void operator delete(void* frame, std::size_t size) {
+            deallocate_frame(frame, size);
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        // resume the awaiting coroutine by symmetric transfer, so a long chain of tasks does not grow the stack
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            template <typename Promise> std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                auto continuation = handle.promise().continuation_;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {
+            }
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void unhandled_exception() {
+            error_ = std::current_exception();
+        }
+
+        std::coroutine_handle<> continuation_;
+        std::exception_ptr error_;
+    };
+
+    template <typename T> struct Promise : PromiseBase {
+        Task<T> get_return_object();
+
+        template <typename U> void return_value(U&& value) {
+            value_.emplace(std::forward<U>(value));
+        }
+
+        T take() {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+            return std::move(*value_);
+        }
+
+        std::optional<T> value_;
+    };
+
+    template <> struct Promise<void> : PromiseBase {
+        Task<void> get_return_object();
+
+        void return_void() {
+        }
+
+        void take() {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+        }
+    };
+
+    // the root of a spawned task, which frees itself when the task finishes
+    struct Detached {
+        struct promise_type {
+            static void* operator new(std::size_t size) {
+                return allocate_frame(size);
+            }
+
+            static void operator delete(void* frame, std::size_t size) {
+                deallocate_frame(frame, size);
+            }
+
+            Detached get_return_object() {
+                return {};
+            }
+
+            std::suspend_never initial_suspend() noexcept {
+                return {};
+            }
+
+            std::suspend_never final_suspend() noexcept {
+                return {};
+            }
+
+            void return_void() {
+            }
+
+            void unhandled_exception() {
+                std::terminate();
+            }
+        };
+    };
+
+}
+
+// A lazily started coroutine, which runs when it is awaited and resumes its awaiter when it finishes.
+template <typename T> class Task {
+    public:
+    using promise_type = detail::Promise<T>;
+
+    Task(Task&& other) noexcept
+    : handle_ { std::exchange(other.handle_, nullptr) } {
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle_.promise().continuation_ = awaiter;
+        return handle_;
+    }
+
+    T await_resume() {
+        return handle_.promise().take();
+    }
+
+    private:
+    friend struct detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle)
+    : handle_ { handle } {
+    }
+
+    Task(const Task& other) = delete;
+    Task& operator=(const Task& other) = delete;
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+    template <typename T> Task<T> Promise<T>::get_return_object() {
+        return Task<T> { std::coroutine_handle<Promise<T>>::from_promise(*this) };
+    }
+
+    inline Task<void> Promise<void>::get_return_object() {
+        return Task<void> { std::coroutine_handle<Promise<void>>::from_promise(*this) };
+    }
+
+    inline Detached run_detached(Task<void> task) {
+        co_await task;
+    }
+
+}
+
+// start the task on the calling thread, it runs until its first suspension before spawn returns. an exception
+// escaping from it terminates the process
+inline void spawn(Task<void> task) {
+    detail::run_detached(std::move(task));
+}
+
+// the outcome of an awaited operation of a socket
+struct IoResult {
+    Result result;
+    std::size_t size;
+};
+
+namespace detail {
+
+    enum class SocketOperation { READ, READ_SOME, WRITE, WRITE_SOME };
+
+    // an operation of a socket, the awaiter is resumed by its callback on the runtime thread of the socket
+    class SocketAwaiter {
+        public:
+        SocketAwaiter(TcpSocket& socket, SocketOperation operation, uint8_t* buf, std::size_t size, TcpSocket::Duration timeout)
+        : socket_ { socket }
+        , operation_ { operation }
+        , buf_ { buf }
+        , size_ { size }
+        , timeout_ { timeout } {
+        }
+
+        bool await_ready() noexcept {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            auto callback = [this, handle](Result res, std::size_t size) {
+                result_.emplace(IoResult { res, size });
+                handle.resume();
+            };
+            bool submitted = false;
+            switch (operation_) {
+            case SocketOperation::READ:
+                submitted = socket_.async_read(buf_, size_, callback, timeout_);
+                break;
+            case SocketOperation::READ_SOME:
+                submitted = socket_.async_read_some(buf_, size_, callback, timeout_);
+                break;
+            case SocketOperation::WRITE:
+                submitted = socket_.async_write(buf_, size_, callback, timeout_);
+                break;
+            case SocketOperation::WRITE_SOME:
+                submitted = socket_.async_write_some(buf_, size_, callback, timeout_);
+                break;
+            }
+            if (!submitted) {
+                // the callback will never run, so the coroutine goes on without suspending
+                result_.emplace(IoResult { Result::custom_error("the socket is closed"), 0 });
+            }
+            return submitted;
+        }
+
+        IoResult await_resume() {
+            return std::move(*result_);
+        }
+
+        private:
+        TcpSocket& socket_;
+        SocketOperation operation_;
+        uint8_t* buf_;
+        std::size_t size_;
+        TcpSocket::Duration timeout_;
+        std::optional<IoResult> result_;
+    };
+
+    // a timer of a socket or a Timer. a socket which is not registered schedules nothing, then the awaiter
+    // goes on at once
+    template <typename Scheduler> class SleepAwaiter {
+        public:
+        SleepAwaiter(Scheduler& scheduler, TimerScheduler::Duration duration)
+        : scheduler_ { scheduler }
+        , duration_ { duration } {
+        }
+
+        bool await_ready() noexcept {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            // whoever claims it first goes on with the coroutine
+            auto claimed = std::make_shared<std::atomic<bool>>(false);
+            auto timer = scheduler_.async_wait_for(duration_, [claimed, handle](auto, auto) {
+                if (!claimed->exchange(true)) {
+                    handle.resume();
+                }
+            });
+            return timer.is_pending() || claimed->exchange(true);
+        }
+
+        void await_resume() noexcept {
+        }
+
+        private:
+        Scheduler& scheduler_;
+        TimerScheduler::Duration duration_;
+    };
+
+}
+
+// the awaitable counterparts of the callbacks of TcpSocket, the coroutine resumes on the runtime thread of the socket
+inline detail::SocketAwaiter read(TcpSocket& socket, uint8_t* buf, std::size_t size, TcpSocket::Duration timeout = {}) {
+    return { socket, detail::SocketOperation::READ, buf, size, timeout };
+}
+
+inline detail::SocketAwaiter read_some(TcpSocket& socket, uint8_t* buf, std::size_t size, TcpSocket::Duration timeout = {}) {
+    return { socket, detail::SocketOperation::READ_SOME, buf, size, timeout };
+}
+
+inline detail::SocketAwaiter write(TcpSocket& socket, uint8_t* buf, std::size_t size, TcpSocket::Duration timeout = {}) {
+    return { socket, detail::SocketOperation::WRITE, buf, size, timeout };
+}
+
+inline detail::SocketAwaiter write_some(TcpSocket& socket, uint8_t* buf, std::size_t size, TcpSocket::Duration timeout = {}) {
+    return { socket, detail::SocketOperation::WRITE_SOME, buf, size, timeout };
+}
+
+// resume on the runtime thread of the socket after the duration
+inline detail::SleepAwaiter<TcpSocket> sleep_for(TcpSocket& socket, TimerScheduler::Duration duration) {
+    return { socket, duration };
+}
+
+// resume on the thread of the timer after the duration
+inline detail::SleepAwaiter<Timer> sleep_for(Timer& timer, TimerScheduler::Duration duration) {
+    return { timer, duration };
+}
+
+}
+
+#endif
\ No newline at end of file
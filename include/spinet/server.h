@@ -10,6 +10,7 @@
 #include <utility>
 #include <vector>
 
+#include "core/backend.h"
 #include "core/tcp_socket.h"
 
 namespace spinet {
@@ -19,6 +20,21 @@ class Server {
     struct Settings {
         uint16_t workers;
         bool reuse_port;
+        std::size_t io_budget = 256 * 1024; // the bytes a socket may transfer in each direction per event
+        Backend backend = Backend::EPOLL; // the readiness mechanism of the workers
+        std::size_t zerocopy_threshold = 0; // the writes of at least this many bytes use MSG_ZEROCOPY, zero disables it
+        // serve an operation started on the runtime thread of its socket right away, and run its callback
+        // before the async call returns, see TcpSocket::set_inline_completion
+        bool inline_completion = false;
+        std::size_t max_connections = 0; // the connections a worker may hold, the later ones are refused. zero is no limit
+        std::size_t accept_budget = 64; // the connections a worker accepts per event before serving the others
+        // pin each worker to its own cpu, and steer a connection to the worker on the cpu which received it.
+        // the first cpu of each worker is used if worker_cpus is set
+        bool cpu_steering = false;
+        // the cpu set of each worker in turn, the workers are not pinned if it is empty
+        std::vector<std::vector<int>> worker_cpus = {};
+        bool numa_binding = false; // allocate the memory of a worker on the numa node of its first cpu
+        std::string thread_name = "spinet"; // the threads are named with the index of the worker appended
         static Settings default_settings();
         std::optional<std::string> validate();
     };
@@ -44,9 +60,12 @@ class Server {
     Server(const Server& other) = delete;
     Server& operator=(const Server& other) = delete;
 
+    void place_worker(Runtime& worker, std::size_t index);
+
     std::mutex mtx_;
     std::atomic<bool> running_;
     std::vector<Worker> workers_;
+    std::vector<int> worker_cpus_; // the cpu of each worker if cpu_steering is on
 
     std::optional<Settings> settings_;
 };
@@ -4,17 +4,21 @@
 #include <chrono>
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 
+#include "core/timing_wheel.h"
+
 namespace spinet {
 
+// A timer driven by its own thread. The callbacks bound to the I/O of a socket should be scheduled on
+// the socket instead, which runs them on the runtime thread of the socket.
 class Timer {
     public:
-    using Duration = std::chrono::milliseconds;
-    using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
-    using Callback = std::function<void(TimePoint, TimePoint)>;
+    using Duration = TimerScheduler::Duration;
+    using TimePoint = TimerScheduler::TimePoint;
+    using Callback = TimerScheduler::Callback;
 
     Timer(Duration precision = Duration { 1 });
     ~Timer();
@@ -23,24 +27,17 @@ class Timer {
     void stop();
     bool is_running();
 
-    void async_wait_for(Duration duration, const Callback& callback);
-    void async_wait_until(TimePoint time_point, const Callback& callback);
+    TimerHandle async_wait_for(Duration duration, const Callback& callback);
+    TimerHandle async_wait_until(TimePoint time_point, const Callback& callback);
 
     private:
-    struct WaitOperation {
-        TimePoint time_point;
-        Callback callback;
-        friend bool operator<(const WaitOperation& x, const WaitOperation& y) {
-            return x.time_point < y.time_point;
-        }
-    };
-
     Timer(Timer&& other) = delete;
     Timer& operator=(Timer&& other) = delete;
     Timer(const Timer& other) = delete;
     Timer& operator=(const Timer& other) = delete;
 
     void exec();
+    void notify();
 
     Timer::Duration precision_;
 
@@ -51,7 +48,7 @@ class Timer {
 
     std::mutex waiter_mtx_;
     std::condition_variable waiter_cv_;
-    std::priority_queue<WaitOperation> waiters_;
+    std::shared_ptr<TimerScheduler> scheduler_;
 };
 
 }
\ No newline at end of file
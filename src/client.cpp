@@ -8,17 +8,128 @@
 
 #include "spinet/client.h"
 
+namespace spinet {
+
+class TcpConnector : public BaseConnector {
+    public:
+    TcpConnector(int fd, const Address& address, Client::Settings* settings, Client::ConnectCallback callback)
+    : address_ { address }
+    , settings_ { settings }
+    , callback_ { std::move(callback) }
+    , timer_ {}
+    , finished_ { false } {
+        fd_ = fd;
+    }
+    ~TcpConnector() {
+        timer_.cancel();
+        if (!finished_) {
+            // dropped by a stopped runtime
+            ::close(fd_);
+            callback_(Result::system_error(ECANCELED), nullptr);
+        }
+    }
+
+    // called on the runtime thread, so the timer cannot race with the completion
+    void arm_timeout(TimerScheduler::TimePoint deadline) {
+        auto runtime = runtime_.lock();
+        if (finished_ || !runtime) {
+            return;
+        }
+        std::weak_ptr<Handle> weak = weak_from_this();
+        timer_ = runtime->timers()->schedule(deadline, [weak](auto, auto) {
+            if (auto self = weak.lock()) {
+                static_cast<TcpConnector*>(self.get())->finish(ETIMEDOUT);
+            }
+        });
+    }
+
+    protected:
+    void do_connect() override {
+        if (finished_) {
+            return;
+        }
+        int ec {};
+        ::socklen_t length = sizeof(ec);
+        if (::getsockopt(fd_, SOL_SOCKET, SO_ERROR, &ec, &length) == -1) {
+            ec = errno;
+        }
+        if (ec != 0) {
+            finish(ec);
+            return;
+        }
+        // no error is also reported while the connect is still in progress
+        ::sockaddr_storage peer {};
+        ::socklen_t peer_length = sizeof(peer);
+        if (::getpeername(fd_, reinterpret_cast<::sockaddr*>(&peer), &peer_length) == 0) {
+            finish(0);
+        }
+    }
+
+    private:
+    void finish(int ec) {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+        timer_.cancel();
+        auto runtime = runtime_.lock();
+        if (ec != 0 || !runtime) {
+            close();
+            callback_(Result::system_error(ec != 0 ? ec : ECANCELED), nullptr);
+            return;
+        }
+        // hand the fd over to a socket on the same runtime
+        runtime->deregister_handle(this);
+        auto socket = runtime->make_pooled<TcpSocket>(fd_, address_);
+        socket->set_io_budget(settings_->io_budget);
+        socket->set_zerocopy_threshold(settings_->zerocopy_threshold);
+        socket->set_inline_completion(settings_->inline_completion);
+        runtime->register_handle(socket);
+        callback_(Result::ok(), socket);
+    }
+
+    Address address_;
+    Client::Settings* settings_;
+    Client::ConnectCallback callback_;
+    TimerHandle timer_;
+    bool finished_; // only touched by the runtime thread
+};
+
+}
+
 using namespace spinet;
 
 std::optional<std::string> Client::Settings::validate() {
     if (workers < 1) {
         return "workers must be more than zero";
     }
+    if (io_budget < 1) {
+        return "io_budget must be more than zero";
+    }
+    for (auto& cpus : worker_cpus) {
+        if (cpus.empty()) {
+            return "worker_cpus must not contain an empty set";
+        }
+        for (int cpu : cpus) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE) {
+                return "worker_cpus contains an invalid cpu";
+            }
+        }
+    }
     return {};
 }
 
 Client::Settings Client::Settings::default_settings() {
-    return { .workers = 1, .reuse_port = false };
+    return { .workers = 1,
+        .reuse_port = false,
+        .io_budget = 256 * 1024,
+        .backend = Backend::EPOLL,
+        .zerocopy_threshold = 0,
+        .inline_completion = false,
+        .worker_cpus = {},
+        .numa_binding = false,
+        .thread_name = "spinet",
+        .placement = Placement::ROUND_ROBIN };
 }
 
 Client::Client()
@@ -46,11 +157,28 @@ std::optional<std::string> Client::with_settings(Settings settings) {
     }
     settings_ = settings;
     for (std::size_t i = 0; i < settings_->workers; i++) {
-        workers_.push_back(std::shared_ptr<Runtime> { new Runtime() });
+        workers_.push_back(std::shared_ptr<Runtime> { new Runtime(settings_->backend) });
+        place_worker(*workers_.back(), i);
     }
     return {};
 }
 
+void Client::place_worker(Runtime& worker, std::size_t index) {
+    worker.set_thread_name(settings_->thread_name + std::to_string(index));
+    auto& sets = settings_->worker_cpus;
+    if (sets.empty()) {
+        return;
+    }
+    auto& cpus = sets[index % sets.size()];
+    worker.set_cpu_affinity(cpus);
+    if (settings_->numa_binding) {
+        int node = numa_node_of_cpu(cpus[0]);
+        if (node >= 0) {
+            worker.bind_numa_node(node);
+        }
+    }
+}
+
 std::variant<std::shared_ptr<TcpSocket>, std::string> Client::tcp_connect(Address& address) {
     std::unique_lock<std::mutex> lck { mtx_ };
     if (!running_) {
@@ -59,30 +187,65 @@ std::variant<std::shared_ptr<TcpSocket>, std::string> Client::tcp_connect(Addres
     if (!settings_) {
         return "settings has been not set";
     }
-    auto res = to_sockaddr_in(address.address().c_str(), address.port());
-    if (res.index() == 1) {
-        return std::get<1>(res);
-    }
-    ::sockaddr_in socket_address = std::get<0>(res);
-    int fd = ::socket(socket_address.sin_family, SOCK_STREAM, 0);
+    int fd = ::socket(address.sockaddr()->sa_family, SOCK_STREAM, 0);
     if (fd == -1) {
         return std::string { "socket cannot be created, reason:" } + std::strerror(errno);
     }
     if (settings_->reuse_port) {
         set_reuse_port(fd);
     }
-    if (::connect(fd, reinterpret_cast<::sockaddr*>(&socket_address), sizeof(socket_address)) == -1) {
-        std::string err = std::string { "socket cannot be listened, reason:" } + std::strerror(errno);
+    // the other connects need not wait for this one
+    lck.unlock();
+    if (::connect(fd, address.sockaddr(), address.sockaddr_length()) == -1) {
+        int ec = errno;
+        std::string err = "socket cannot connect to " + address.to_string() + ", reason:" + std::strerror(ec);
         ::close(fd);
         return err;
     }
     set_nonblock(fd);
-    std::shared_ptr<TcpSocket> socket { new TcpSocket(
-    fd, std::get<0>(Address::parse(from_sockaddr_in(socket_address), ntohs(socket_address.sin_port)))) };
-    select_runtime()->register_handle(socket);
+    auto runtime = select_runtime();
+    auto socket = runtime->make_pooled<TcpSocket>(fd, address);
+    socket->set_io_budget(settings_->io_budget);
+    socket->set_zerocopy_threshold(settings_->zerocopy_threshold);
+    socket->set_inline_completion(settings_->inline_completion);
+    runtime->register_handle(socket);
     return socket;
 }
 
+std::optional<std::string>
+Client::async_tcp_connect(Address& address, TcpSocket::Duration timeout, const ConnectCallback& callback) {
+    std::unique_lock<std::mutex> lck { mtx_ };
+    if (!running_) {
+        return "client is not running";
+    }
+    if (!settings_) {
+        return "settings has been not set";
+    }
+    int fd = ::socket(address.sockaddr()->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return std::string { "socket cannot be created, reason:" } + std::strerror(errno);
+    }
+    if (settings_->reuse_port) {
+        set_reuse_port(fd);
+    }
+    if (::connect(fd, address.sockaddr(), address.sockaddr_length()) == -1 && errno != EINPROGRESS) {
+        int ec = errno;
+        std::string err = "socket cannot connect to " + address.to_string() + ", reason:" + std::strerror(ec);
+        ::close(fd);
+        return err;
+    }
+    auto runtime = select_runtime();
+    // the connector is notified when the socket becomes writable, or checked on the next iteration if the connect
+    // has finished already
+    auto connector = runtime->make_pooled<TcpConnector>(fd, address, &settings_.value(), callback);
+    runtime->register_handle(connector);
+    if (timeout > TcpSocket::Duration::zero()) {
+        auto deadline = TimerScheduler::Clock::now() + timeout;
+        runtime->post([connector, deadline]() { connector->arm_timeout(deadline); });
+    }
+    return {};
+}
+
 std::optional<std::string> Client::run() {
     bool expected = false;
     if (!running_.compare_exchange_weak(expected, true)) {
@@ -105,10 +268,13 @@ void Client::stop() {
     if (!running_) {
         return;
     }
+    running_ = false;
+    // the workers are joined without the lock, since the callbacks cancelled by a stopping worker may call back
+    // into this client
+    lck.unlock();
     for (auto& worker : workers_) {
         worker->stop();
     }
-    running_ = false;
 }
 
 bool Client::is_running() {
@@ -116,6 +282,37 @@ bool Client::is_running() {
 }
 
 std::shared_ptr<spinet::Runtime>& Client::select_runtime() {
-    auto index = (choosen_index_++) % workers_.size();
-    return workers_[index];
+    switch (settings_->placement) {
+    case Placement::LEAST_CONNECTIONS:
+        return least_loaded_runtime(&Runtime::current_load);
+    case Placement::LEAST_PENDING_BYTES:
+        return least_loaded_runtime(&Runtime::pending_bytes);
+    case Placement::CURRENT_WORKER:
+        for (auto& worker : workers_) {
+            if (worker->in_runtime_thread()) {
+                return worker;
+            }
+        }
+        return least_loaded_runtime(&Runtime::current_load);
+    default: // the alternative is ROUND_ROBIN
+        auto index = (choosen_index_++) % workers_.size();
+        return workers_[index];
+    }
+}
+
+std::shared_ptr<spinet::Runtime>& Client::least_loaded_runtime(std::size_t (Runtime::*load)()) {
+    // the loads are read without any lock, so concurrent connections may pick the same worker. the scan starts
+    // from a rotating index to spread the ties
+    std::size_t start = (choosen_index_++) % workers_.size();
+    std::size_t chosen = start;
+    std::size_t chosen_load = SIZE_MAX;
+    for (std::size_t i = 0; i < workers_.size(); i++) {
+        std::size_t index = (start + i) % workers_.size();
+        std::size_t current = (workers_[index].get()->*load)();
+        if (current < chosen_load) {
+            chosen = index;
+            chosen_load = current;
+        }
+    }
+    return workers_[chosen];
 }
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include <chrono>
+#include <utility>
+
+#include "spinet/connection_pool.h"
+
+using namespace spinet;
+
+static int64_t now_millis() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+
+static bool is_healthy(const std::shared_ptr<TcpSocket>& socket) {
+    return !socket->is_closed() && !socket->is_peer_closed();
+}
+
+std::optional<std::string> ConnectionPool::Settings::validate() {
+    if (connections < 1) {
+        return "connections must be more than zero";
+    }
+    if (connect_timeout < TcpSocket::Duration::zero()) {
+        return "connect_timeout must not be negative";
+    }
+    if (retry_interval < TcpSocket::Duration::zero()) {
+        return "retry_interval must not be negative";
+    }
+    if (idle_check_interval < TcpSocket::Duration::zero()) {
+        return "idle_check_interval must not be negative";
+    }
+    return {};
+}
+
+ConnectionPool::Settings ConnectionPool::Settings::default_settings() {
+    return { .connections = 8,
+        .connect_timeout = TcpSocket::Duration { 3000 },
+        .retry_interval = TcpSocket::Duration { 1000 },
+        .idle_check_interval = TcpSocket::Duration { 1000 } };
+}
+
+ConnectionPool::Lease::Lease()
+: destination_ {}
+, slot_ { 0 }
+, socket_ {} {
+}
+
+ConnectionPool::Lease::Lease(std::shared_ptr<Destination> destination, std::size_t slot, std::shared_ptr<TcpSocket> socket)
+: destination_ { std::move(destination) }
+, slot_ { slot }
+, socket_ { std::move(socket) } {
+}
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+: destination_ { std::move(other.destination_) }
+, slot_ { other.slot_ }
+, socket_ { std::move(other.socket_) } {
+}
+
+ConnectionPool::Lease& ConnectionPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        destination_ = std::move(other.destination_);
+        slot_ = other.slot_;
+        socket_ = std::move(other.socket_);
+    }
+    return *this;
+}
+
+ConnectionPool::Lease::~Lease() {
+    release();
+}
+
+const std::shared_ptr<TcpSocket>& ConnectionPool::Lease::socket() {
+    return socket_;
+}
+
+ConnectionPool::Lease::operator bool() {
+    return socket_ != nullptr;
+}
+
+void ConnectionPool::Lease::release() {
+    if (!destination_) {
+        return;
+    }
+    destination_->give_back(slot_, socket_);
+    destination_.reset();
+    socket_.reset();
+}
+
+ConnectionPool::Destination::Destination(Client* client, const Settings& settings, const Address& address)
+: client_ { client }
+, settings_ { settings }
+, address_ { address }
+, slots_ { new Slot[settings.connections] }
+, next_slot_ { 0 }
+, sweep_armed_ { false } {
+}
+
+ConnectionPool::Destination::~Destination() {
+    // no lease and no connect callback holds the destination any more
+    for (std::size_t i = 0; i < settings_.connections; i++) {
+        if (slots_[i].socket) {
+            slots_[i].socket->close();
+        }
+    }
+}
+
+ConnectionPool::Lease ConnectionPool::Destination::lease() {
+    std::size_t count = settings_.connections;
+    std::size_t start = next_slot_.fetch_add(1, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < count; i++) {
+        std::size_t index = (start + i) % count;
+        auto& slot = slots_[index];
+        uint8_t state = slot.state.load(std::memory_order_acquire);
+        if (state == SLOT_EMPTY) {
+            // retry a failed connect once its interval has passed
+            if (now_millis() >= slot.retry_at.load(std::memory_order_relaxed) &&
+            slot.state.compare_exchange_strong(state, SLOT_CONNECTING, std::memory_order_acq_rel)) {
+                connect(index);
+            }
+            continue;
+        }
+        if (state != SLOT_IDLE ||
+        !slot.state.compare_exchange_strong(state, SLOT_LEASED, std::memory_order_acq_rel)) {
+            continue;
+        }
+        if (is_healthy(slot.socket)) {
+            return Lease { shared_from_this(), index, slot.socket };
+        }
+        // the peer has hung up while the connection was idle, so it is replaced in the background
+        replace(index);
+    }
+    return {};
+}
+
+Address ConnectionPool::Destination::address() {
+    return address_;
+}
+
+void ConnectionPool::Destination::connect(std::size_t index) {
+    std::weak_ptr<Destination> weak = weak_from_this();
+    auto err = client_->async_tcp_connect(
+    address_, settings_.connect_timeout, [weak, index](Result res, std::shared_ptr<TcpSocket> socket) {
+        auto self = weak.lock();
+        if (!self) {
+            if (socket) {
+                socket->close();
+            }
+            return;
+        }
+        if (!res) {
+            self->fail(index);
+            return;
+        }
+        auto& slot = self->slots_[index];
+        slot.socket = std::move(socket);
+        self->arm_sweep(slot.socket);
+        slot.state.store(SLOT_IDLE, std::memory_order_release);
+    });
+    if (err) {
+        fail(index);
+    }
+}
+
+void ConnectionPool::Destination::give_back(std::size_t index, const std::shared_ptr<TcpSocket>& socket) {
+    auto& slot = slots_[index];
+    if (is_healthy(socket)) {
+        arm_sweep(socket);
+        slot.state.store(SLOT_IDLE, std::memory_order_release);
+        return;
+    }
+    replace(index);
+}
+
+void ConnectionPool::Destination::arm_sweep(const std::shared_ptr<TcpSocket>& socket) {
+    if (settings_.idle_check_interval == TcpSocket::Duration::zero() || sweep_armed_.load(std::memory_order_relaxed) ||
+    sweep_armed_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    std::weak_ptr<Destination> weak = weak_from_this();
+    auto timer = socket->async_wait_for(settings_.idle_check_interval, [weak](auto, auto) {
+        if (auto self = weak.lock()) {
+            self->sweep();
+        }
+    });
+    if (!timer.is_pending()) {
+        // the socket has left its runtime, the next idle socket arms the sweep instead
+        sweep_armed_.store(false, std::memory_order_release);
+    }
+}
+
+void ConnectionPool::Destination::sweep() {
+    sweep_armed_.store(false, std::memory_order_release);
+    std::shared_ptr<TcpSocket> idle {};
+    for (std::size_t i = 0; i < settings_.connections; i++) {
+        auto& slot = slots_[i];
+        // claim the slot like a lease, a leased or connecting one arms the sweep when it becomes idle again
+        uint8_t state = SLOT_IDLE;
+        if (!slot.state.compare_exchange_strong(state, SLOT_LEASED, std::memory_order_acq_rel)) {
+            continue;
+        }
+        if (!is_healthy(slot.socket)) {
+            replace(i);
+            continue;
+        }
+        idle = slot.socket;
+        slot.state.store(SLOT_IDLE, std::memory_order_release);
+    }
+    // the sweeps go on while any connection is idle
+    if (idle) {
+        arm_sweep(idle);
+    }
+}
+
+void ConnectionPool::Destination::replace(std::size_t index) {
+    auto& slot = slots_[index];
+    slot.socket->close();
+    slot.socket.reset();
+    slot.state.store(SLOT_CONNECTING, std::memory_order_release);
+    connect(index);
+}
+
+void ConnectionPool::Destination::fail(std::size_t index) {
+    auto& slot = slots_[index];
+    slot.retry_at.store(now_millis() + settings_.retry_interval.count(), std::memory_order_relaxed);
+    slot.state.store(SLOT_EMPTY, std::memory_order_release);
+}
+
+ConnectionPool::ConnectionPool(Client& client)
+: client_ { &client }
+, settings_ {}
+, destinations_ {} {
+}
+
+ConnectionPool::~ConnectionPool() {
+}
+
+std::optional<std::string> ConnectionPool::with_settings(Settings settings) {
+    std::unique_lock<std::mutex> lck { mtx_ };
+    if (settings_) {
+        return "settings has been set";
+    }
+    if (auto err = settings.validate()) {
+        return err;
+    }
+    settings_ = settings;
+    return {};
+}
+
+std::variant<std::shared_ptr<ConnectionPool::Destination>, std::string> ConnectionPool::add_destination(Address& address) {
+    std::unique_lock<std::mutex> lck { mtx_ };
+    if (!settings_) {
+        return "settings has been not set";
+    }
+    if (!client_->is_running()) {
+        return "client is not running";
+    }
+    std::shared_ptr<Destination> destination { new Destination(client_, settings_.value(), address) };
+    for (std::size_t i = 0; i < settings_->connections; i++) {
+        destination->slots_[i].state.store(Destination::SLOT_CONNECTING, std::memory_order_relaxed);
+        destination->connect(i);
+    }
+    destinations_.push_back(destination);
+    return destination;
+}
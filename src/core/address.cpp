@@ -1,9 +1,12 @@
-#include <utility>
+#include <algorithm>
+#include <cstring>
 
-#include "netdb.h"
+#include "arpa/inet.h"
+#include "netinet/in.h"
 
+#include "resolver.h"
+#include "runtime.h"
 #include "spinet/core/address.h"
-#include "util.h"
 
 using namespace spinet;
 
@@ -11,27 +14,19 @@ Address::~Address() {
 }
 
 std::variant<Address, std::string> Address::parse(const char* ip, uint16_t port) {
-    auto res = to_sockaddr_in(ip, port);
-    if (res.index() == 1) {
-        return std::get<1>(res);
-    } else {
-        auto& sockaddr = std::get<0>(res);
-        std::size_t len {};
-        Type type {};
-        char buf[std::max(INET_ADDRSTRLEN, INET6_ADDRSTRLEN)] = { 0 };
-        if (sockaddr.sin_family == AF_INET) {
-            len = INET_ADDRSTRLEN;
-            type = IPV4;
-        } else {
-            len = INET6_ADDRSTRLEN;
-            type = IPV6;
-        }
-        if (::inet_ntop(sockaddr.sin_family, &sockaddr.sin_addr, buf, len) != nullptr) {
-            return Address { type, std::string { buf }, port };
-        } else {
-            return std::string { "sockaddr is invalid, reason:" } + std::strerror(errno);
-        }
+    ::sockaddr_in address {};
+    if (::inet_pton(AF_INET, ip, &address.sin_addr) == 1) {
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        return Address { reinterpret_cast<::sockaddr*>(&address), sizeof(address) };
     }
+    ::sockaddr_in6 address6 {};
+    if (::inet_pton(AF_INET6, ip, &address6.sin6_addr) == 1) {
+        address6.sin6_family = AF_INET6;
+        address6.sin6_port = htons(port);
+        return Address { reinterpret_cast<::sockaddr*>(&address6), sizeof(address6) };
+    }
+    return std::string { "parse failed, " } + ip + " is not a valid ip";
 }
 
 std::variant<Address, std::string> Address::parse(const std::string& ip, uint16_t port) {
@@ -39,59 +34,95 @@ std::variant<Address, std::string> Address::parse(const std::string& ip, uint16_
 }
 
 std::variant<std::vector<Address>, std::string> Address::resolve(const char* domain, uint16_t port) {
-    ::addrinfo hints {};
-    hints.ai_family = PF_UNSPEC;
-    ::addrinfo* res = nullptr;
-    {
-        int ec = ::getaddrinfo(domain, nullptr, &hints, &res);
-        if (ec != 0) {
-            return ::gai_strerror(ec);
-        }
-    }
-    std::vector<Address> addresses {};
-    for (::addrinfo* iter = res; iter != nullptr; iter = iter->ai_next) {
-        if (iter->ai_protocol != IPPROTO_IP) {
-            continue;
-        }
-        char buf[std::max(INET_ADDRSTRLEN, INET6_ADDRSTRLEN)] = { 0 };
-        if (iter->ai_family == AF_INET) {
-            sockaddr_in* sockaddr = (sockaddr_in*)iter->ai_addr;
-            ::inet_ntop(AF_INET, &sockaddr->sin_addr, buf, INET_ADDRSTRLEN);
-            Address address { IPV4, std::string { buf }, port };
-            addresses.push_back(address);
-        } else {
-            sockaddr_in6* sockaddr = (sockaddr_in6*)iter->ai_addr;
-            ::inet_ntop(AF_INET6, &sockaddr->sin6_addr, buf, INET6_ADDRSTRLEN);
-            Address address { IPV6, std::string { buf }, port };
-            addresses.push_back(address);
-        }
-    }
-    ::freeaddrinfo(res);
-    return addresses;
+    return with_port(Resolver::instance().resolve(domain), port);
 }
 
 std::variant<std::vector<Address>, std::string> Address::resolve(const std::string& domain, uint16_t port) {
     return resolve(domain.c_str(), port);
 }
 
+void Address::async_resolve(const std::string& domain, uint16_t port, const ResolveCallback& callback) {
+    // a caller on a runtime thread gets the result back on that thread
+    std::weak_ptr<Runtime> caller {};
+    if (auto runtime = Runtime::current()) {
+        caller = runtime->weak_from_this();
+    }
+    Resolver::instance().async_resolve(domain, [port, callback, caller](const Resolver::Resolution& resolution) {
+        auto runtime = caller.lock();
+        if (!runtime || runtime->in_runtime_thread()) {
+            callback(with_port(resolution, port));
+            return;
+        }
+        auto addresses = with_port(resolution, port);
+        runtime->post([callback, addresses]() { callback(addresses); });
+    });
+}
+
+std::variant<Address, std::string> Address::from_sockaddr(const ::sockaddr* address, ::socklen_t length) {
+    if (address->sa_family == AF_INET && length >= sizeof(::sockaddr_in)) {
+        return Address { address, sizeof(::sockaddr_in) };
+    }
+    if (address->sa_family == AF_INET6 && length >= sizeof(::sockaddr_in6)) {
+        return Address { address, sizeof(::sockaddr_in6) };
+    }
+    return "sockaddr is invalid, only ipv4 and ipv6 are supported";
+}
+
 Address::Type Address::type() {
-    return type_;
+    return storage_.ss_family == AF_INET6 ? IPV6 : IPV4;
 }
 
 std::string Address::address() {
-    return address_;
+    char buf[std::max(INET_ADDRSTRLEN, INET6_ADDRSTRLEN)] = { 0 };
+    if (storage_.ss_family == AF_INET6) {
+        ::inet_ntop(AF_INET6, &reinterpret_cast<::sockaddr_in6*>(&storage_)->sin6_addr, buf, INET6_ADDRSTRLEN);
+    } else {
+        ::inet_ntop(AF_INET, &reinterpret_cast<::sockaddr_in*>(&storage_)->sin_addr, buf, INET_ADDRSTRLEN);
+    }
+    return { buf };
 }
 
 uint16_t Address::port() {
-    return port_;
+    if (storage_.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<::sockaddr_in6*>(&storage_)->sin6_port);
+    } else {
+        return ntohs(reinterpret_cast<::sockaddr_in*>(&storage_)->sin_port);
+    }
 }
 
 std::string Address::to_string() {
-    return address_ + ":" + std::to_string(port_);
+    if (storage_.ss_family == AF_INET6) {
+        return "[" + address() + "]:" + std::to_string(port());
+    } else {
+        return address() + ":" + std::to_string(port());
+    }
+}
+
+const ::sockaddr* Address::sockaddr() {
+    return reinterpret_cast<const ::sockaddr*>(&storage_);
+}
+
+::socklen_t Address::sockaddr_length() {
+    return storage_.ss_family == AF_INET6 ? sizeof(::sockaddr_in6) : sizeof(::sockaddr_in);
+}
+
+std::variant<std::vector<Address>, std::string>
+Address::with_port(const std::variant<std::vector<Address>, std::string>& resolution, uint16_t port) {
+    if (resolution.index() == 1) {
+        return std::get<1>(resolution);
+    }
+    std::vector<Address> addresses = std::get<0>(resolution);
+    for (auto& address : addresses) {
+        if (address.type() == IPV4) {
+            reinterpret_cast<::sockaddr_in*>(&address.storage_)->sin_port = htons(port);
+        } else {
+            reinterpret_cast<::sockaddr_in6*>(&address.storage_)->sin6_port = htons(port);
+        }
+    }
+    return addresses;
 }
 
-Address::Address(Type type, std::string address, uint16_t port)
-: type_ { type }
-, address_ { std::move(address) }
-, port_ { port } {
+Address::Address(const ::sockaddr* address, ::socklen_t length)
+: storage_ {} {
+    std::memcpy(&storage_, address, length);
 }
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <utility>
+
+#include "slab_pool.h"
+#include "spinet/core/buffer.h"
+
+using namespace spinet;
+
+struct Buffer::Block {
+    std::atomic<uint32_t> refs;
+    std::size_t allocated; // the size of the block including this header
+    std::shared_ptr<SlabPool> pool; // empty if the block is from the global heap
+};
+
+// the bytes follow the header, so they start on a cache line in a pooled block
+constexpr std::size_t BLOCK_HEADER_SIZE = CACHE_LINE_SIZE;
+
+Buffer::Buffer()
+: block_ { nullptr }
+, data_ { nullptr }
+, size_ { 0 } {
+}
+
+Buffer::Buffer(const Buffer& other)
+: block_ { other.block_ }
+, data_ { other.data_ }
+, size_ { other.size_ } {
+    if (block_ != nullptr) {
+        block_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+Buffer::Buffer(Buffer&& other) noexcept
+: block_ { std::exchange(other.block_, nullptr) }
+, data_ { std::exchange(other.data_, nullptr) }
+, size_ { std::exchange(other.size_, 0) } {
+}
+
+Buffer& Buffer::operator=(const Buffer& other) {
+    if (this != &other) {
+        Buffer copy { other };
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        block_ = std::exchange(other.block_, nullptr);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+Buffer::~Buffer() {
+    release();
+}
+
+Buffer Buffer::allocate(std::size_t size) {
+    return allocate(size, nullptr);
+}
+
+uint8_t* Buffer::data() {
+    return data_;
+}
+
+std::size_t Buffer::size() {
+    return size_;
+}
+
+bool Buffer::empty() {
+    return size_ == 0;
+}
+
+Buffer Buffer::slice(std::size_t offset, std::size_t size) {
+    offset = std::min(offset, size_);
+    size = std::min(size, size_ - offset);
+    if (block_ != nullptr) {
+        block_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return Buffer { block_, data_ + offset, size };
+}
+
+Buffer Buffer::allocate(std::size_t size, const std::shared_ptr<SlabPool>& pool) {
+    static_assert(sizeof(Block) <= BLOCK_HEADER_SIZE, "the header does not fit");
+    if (size == 0) {
+        return {};
+    }
+    std::size_t allocated = BLOCK_HEADER_SIZE + size;
+    void* memory = pool ? pool->allocate(allocated) : ::operator new(allocated);
+    auto block = new (memory) Block { { 1 }, allocated, pool };
+    return Buffer { block, static_cast<uint8_t*>(memory) + BLOCK_HEADER_SIZE, size };
+}
+
+Buffer::Buffer(Block* block, uint8_t* data, std::size_t size)
+: block_ { block }
+, data_ { data }
+, size_ { size } {
+}
+
+void Buffer::release() {
+    if (block_ == nullptr) {
+        return;
+    }
+    if (block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        auto pool = std::move(block_->pool);
+        std::size_t allocated = block_->allocated;
+        block_->~Block();
+        if (pool) {
+            pool->deallocate(block_, allocated);
+        } else {
+            ::operator delete(block_);
+        }
+    }
+    block_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+BufferChain::BufferChain()
+: buffers_ {}
+, size_ { 0 } {
+}
+
+void BufferChain::append(Buffer buffer) {
+    if (buffer.empty()) {
+        return;
+    }
+    size_ = size_ + buffer.size();
+    buffers_.push_back(std::move(buffer));
+}
+
+void BufferChain::append(BufferChain chain) {
+    for (auto& buffer : chain) {
+        append(std::move(buffer));
+    }
+}
+
+void BufferChain::clear() {
+    buffers_.clear();
+    size_ = 0;
+}
+
+std::size_t BufferChain::count() {
+    return buffers_.size();
+}
+
+std::size_t BufferChain::size() {
+    return size_;
+}
+
+bool BufferChain::empty() {
+    return size_ == 0;
+}
+
+Buffer& BufferChain::operator[](std::size_t index) {
+    return buffers_[index];
+}
+
+BufferChain BufferChain::slice(std::size_t offset, std::size_t size) {
+    BufferChain chain {};
+    for (auto& buffer : buffers_) {
+        if (size == 0) {
+            break;
+        }
+        if (offset >= buffer.size()) {
+            offset = offset - buffer.size();
+            continue;
+        }
+        auto part = buffer.slice(offset, size);
+        offset = 0;
+        size = size - part.size();
+        chain.append(std::move(part));
+    }
+    return chain;
+}
+
+std::vector<Buffer>::iterator BufferChain::begin() {
+    return buffers_.begin();
+}
+
+std::vector<Buffer>::iterator BufferChain::end() {
+    return buffers_.end();
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include <algorithm>
+
+#include "sys/epoll.h"
+#include "unistd.h"
+
+#include "epoll_poller.h"
+
+using namespace spinet;
+
+constexpr int EPOLL_WAIT_SIZE = 128;
+
+EpollPoller::EpollPoller() {
+    epoll_fd_ = ::epoll_create(1); // the arg of epoll_create is deprecated
+}
+
+EpollPoller::~EpollPoller() {
+    ::close(epoll_fd_);
+}
+
+Backend EpollPoller::backend() {
+    return Backend::EPOLL;
+}
+
+bool EpollPoller::add(int fd, void* data, uint32_t events) {
+    ::epoll_event ev { 0, { 0 } };
+    ev.events = events;
+    ev.data.ptr = data;
+    return ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+bool EpollPoller::modify(int fd, void* data, uint32_t events) {
+    ::epoll_event ev { 0, { 0 } };
+    ev.events = events;
+    ev.data.ptr = data;
+    return ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+bool EpollPoller::add_listener(int, void*) {
+    return false;
+}
+
+void EpollPoller::remove(int fd) {
+    ::epoll_event ev { 0, { 0 } };
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int EpollPoller::wait(Event* events, int capacity, int timeout) {
+    ::epoll_event epoll_events[EPOLL_WAIT_SIZE];
+    int event_size = ::epoll_wait(epoll_fd_, epoll_events, std::min(capacity, EPOLL_WAIT_SIZE), timeout);
+    for (int i = 0; i < event_size; i++) {
+        events[i] = { epoll_events[i].data.ptr, epoll_events[i].events, -1 };
+    }
+    return event_size < 0 ? 0 : event_size;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "poller.h"
+
+namespace spinet {
+
+class EpollPoller : public Poller {
+    public:
+    EpollPoller();
+    ~EpollPoller();
+
+    Backend backend() override;
+    bool add(int fd, void* data, uint32_t events) override;
+    bool add_listener(int fd, void* data) override;
+    bool modify(int fd, void* data, uint32_t events) override;
+    void remove(int fd) override;
+    int wait(Event* events, int capacity, int timeout) override;
+
+    private:
+    EpollPoller(EpollPoller&& other) = delete;
+    EpollPoller& operator=(EpollPoller&& other) = delete;
+    EpollPoller(const EpollPoller& other) = delete;
+    EpollPoller& operator=(const EpollPoller& other) = delete;
+
+    int epoll_fd_;
+};
+
+}
\ No newline at end of file
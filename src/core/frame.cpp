@@ -0,0 +1,39 @@
+#include <memory>
+#include <new>
+
+#include "runtime.h"
+#include "slab_pool.h"
+#include "spinet/core/frame.h"
+
+using namespace spinet;
+
+struct FrameHeader {
+    std::shared_ptr<SlabPool> pool; // empty if the frame is from the global heap
+};
+
+// keeps the frame aligned as the global operator new would
+constexpr std::size_t FRAME_HEADER_SIZE = 2 * __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+void* spinet::allocate_frame(std::size_t size) {
+    static_assert(sizeof(FrameHeader) <= FRAME_HEADER_SIZE, "the header does not fit");
+    std::size_t allocated = FRAME_HEADER_SIZE + size;
+    std::shared_ptr<SlabPool> pool {};
+    if (auto runtime = Runtime::current()) {
+        pool = runtime->pool();
+    }
+    void* memory = pool ? pool->allocate(allocated) : ::operator new(allocated);
+    new (memory) FrameHeader { std::move(pool) };
+    return static_cast<uint8_t*>(memory) + FRAME_HEADER_SIZE;
+}
+
+void spinet::deallocate_frame(void* frame, std::size_t size) {
+    void* memory = static_cast<uint8_t*>(frame) - FRAME_HEADER_SIZE;
+    auto header = static_cast<FrameHeader*>(memory);
+    auto pool = std::move(header->pool);
+    header->~FrameHeader();
+    if (pool) {
+        pool->deallocate(memory, FRAME_HEADER_SIZE + size);
+    } else {
+        ::operator delete(memory);
+    }
+}
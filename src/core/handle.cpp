@@ -1,3 +1,4 @@
+#include "sys/epoll.h"
 #include "unistd.h"
 
 #include "runtime.h"
@@ -15,8 +16,76 @@ void Handle::close() {
     ::close(fd_);
 }
 
+bool Handle::is_listener() {
+    return false;
+}
+
+void Handle::on_accepted(int fd) {
+    ::close(fd);
+}
+
 BaseAcceptor::~BaseAcceptor() {
 }
 
+uint32_t BaseAcceptor::interest_events() {
+    return EPOLLIN | EPOLLRDHUP;
+}
+
+void BaseAcceptor::on_events(uint32_t events) {
+    if (events & EPOLLIN) {
+        do_accept();
+    } else {
+        close();
+    }
+}
+
+bool BaseAcceptor::is_listener() {
+    return true;
+}
+
+void BaseAcceptor::on_accepted(int fd) {
+    // the acceptor may have been closed earlier in the same batch of events
+    if (runtime_.expired()) {
+        ::close(fd);
+        return;
+    }
+    do_accepted(fd);
+}
+
+BaseConnector::~BaseConnector() {
+}
+
+uint32_t BaseConnector::interest_events() {
+    return EPOLLOUT | EPOLLET | EPOLLRDHUP;
+}
+
+void BaseConnector::on_events(uint32_t) {
+    // a failed connect is reported by the error of the socket rather than the events
+    do_connect();
+}
+
 BaseSocket::~BaseSocket() {
+}
+
+uint32_t BaseSocket::interest_events() {
+    return EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET | EPOLLRDHUP;
+}
+
+void BaseSocket::on_events(uint32_t events) {
+    // an error event may only report the completions queued on the error queue
+    bool handled = (events & EPOLLERR) && do_error();
+    if (events & (EPOLLRDHUP | EPOLLHUP)) {
+        do_hangup();
+    }
+    // the socket is edge-triggered, so both directions must be served on every event
+    if (events & (EPOLLIN | EPOLLPRI | EPOLLOUT)) {
+        if (events & (EPOLLIN | EPOLLPRI)) {
+            do_read();
+        }
+        if (events & EPOLLOUT) {
+            do_write();
+        }
+    } else if (!handled) {
+        close();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,18 @@
+#include "epoll_poller.h"
+#include "poller.h"
+#include "uring_poller.h"
+
+using namespace spinet;
+
+std::unique_ptr<Poller> Poller::create(Backend backend) {
+    if (backend == Backend::URING_POLL) {
+        std::unique_ptr<UringPoller> poller { new UringPoller() };
+        if (poller->is_available()) {
+            return poller;
+        }
+    }
+    return std::unique_ptr<Poller> { new EpollPoller() };
+}
+
+Poller::~Poller() {
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "spinet/core/backend.h"
+
+namespace spinet {
+
+// The readiness notification mechanism behind a runtime, the event masks use the epoll flags.
+class Poller {
+    public:
+    struct Event {
+        void* data;
+        uint32_t events;
+        int accepted_fd; // a connection accepted by the kernel for a listener added by add_listener, -1 otherwise
+    };
+
+    // falls back to epoll if the requested backend cannot be used on this kernel
+    static std::unique_ptr<Poller> create(Backend backend);
+
+    virtual ~Poller();
+
+    virtual Backend backend() = 0;
+    virtual bool add(int fd, void* data, uint32_t events) = 0;
+    // accept the connections of the listener in the kernel, which are reported one by one with accepted_fd instead of
+    // the readiness of the listener. false if the backend cannot, the listener is then added by add
+    virtual bool add_listener(int fd, void* data) = 0;
+    virtual bool modify(int fd, void* data, uint32_t events) = 0;
+    virtual void remove(int fd) = 0;
+    // timeout is in milliseconds, -1 blocks until an event arrives
+    virtual int wait(Event* events, int capacity, int timeout) = 0;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "netdb.h"
+
+#include "resolver.h"
+
+using namespace spinet;
+
+Resolver& Resolver::instance() {
+    static Resolver resolver {};
+    return resolver;
+}
+
+Resolver::Resolver()
+: Resolver(&Resolver::lookup, CACHE_TTL, FAILURE_TTL) {
+}
+
+Resolver::Resolver(Lookup lookup, Clock::duration cache_ttl, Clock::duration failure_ttl)
+: lookup_ { std::move(lookup) }
+, cache_ttl_ { cache_ttl }
+, failure_ttl_ { failure_ttl }
+, stopped_ { false } {
+    for (std::size_t i = 0; i < THREADS; i++) {
+        threads_.emplace_back(&Resolver::exec, this);
+    }
+}
+
+Resolver::~Resolver() {
+    std::deque<std::string> jobs {};
+    {
+        std::unique_lock<std::mutex> lck { jobs_mtx_ };
+        stopped_ = true;
+        jobs_.swap(jobs);
+    }
+    jobs_cv_.notify_all();
+    // the lookups in flight complete on their threads
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    for (auto& domain : jobs) {
+        complete(domain, std::string { "resolver has been stopped" });
+    }
+}
+
+Resolver::Resolution Resolver::resolve(const std::string& domain) {
+    auto& shard = shard_of(domain);
+    {
+        std::unique_lock<std::mutex> lck { shard.mtx };
+        auto find = shard.entries.find(domain);
+        if (find != shard.entries.end() && !find->second.resolving && find->second.expiry > Clock::now()) {
+            return find->second.resolution;
+        }
+    }
+    auto resolution = lookup_(domain);
+    std::unique_lock<std::mutex> lck { shard.mtx };
+    auto find = shard.entries.find(domain);
+    if (find == shard.entries.end() || !find->second.resolving) {
+        // a pending asynchronous lookup will store its own result
+        store(shard, domain, resolution);
+    }
+    return resolution;
+}
+
+void Resolver::async_resolve(const std::string& domain, Callback callback) {
+    auto& shard = shard_of(domain);
+    {
+        std::unique_lock<std::mutex> lck { shard.mtx };
+        auto find = shard.entries.find(domain);
+        if (find != shard.entries.end()) {
+            auto& entry = find.value();
+            if (entry.resolving) {
+                entry.waiters.push_back(std::move(callback));
+                return;
+            }
+            if (entry.expiry > Clock::now()) {
+                auto resolution = entry.resolution;
+                lck.unlock();
+                callback(resolution);
+                return;
+            }
+            entry.resolving = true;
+            entry.waiters.push_back(std::move(callback));
+        } else {
+            shard.entries.insert({ domain, Entry { std::string {}, Clock::time_point {}, true, { std::move(callback) } } });
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lck { jobs_mtx_ };
+        if (!stopped_) {
+            jobs_.push_back(domain);
+            lck.unlock();
+            jobs_cv_.notify_one();
+            return;
+        }
+    }
+    // no thread is left to take the job
+    complete(domain, std::string { "resolver has been stopped" });
+}
+
+Resolver::Resolution Resolver::lookup(const std::string& domain) {
+    ::addrinfo hints {};
+    hints.ai_family = PF_UNSPEC;
+    // one entry for each address, rather than one for each socket type
+    hints.ai_socktype = SOCK_STREAM;
+    ::addrinfo* res = nullptr;
+    {
+        int ec = ::getaddrinfo(domain.c_str(), nullptr, &hints, &res);
+        if (ec != 0) {
+            return std::string { ::gai_strerror(ec) };
+        }
+    }
+    std::vector<Address> addresses {};
+    for (::addrinfo* iter = res; iter != nullptr; iter = iter->ai_next) {
+        auto address = Address::from_sockaddr(iter->ai_addr, iter->ai_addrlen);
+        if (address.index() == 1) {
+            continue;
+        }
+        Address& resolved = std::get<0>(address);
+        bool duplicated = std::any_of(addresses.begin(), addresses.end(), [&resolved](Address& other) {
+            return other.sockaddr_length() == resolved.sockaddr_length() &&
+            std::memcmp(other.sockaddr(), resolved.sockaddr(), resolved.sockaddr_length()) == 0;
+        });
+        if (!duplicated) {
+            addresses.push_back(resolved);
+        }
+    }
+    ::freeaddrinfo(res);
+    return addresses;
+}
+
+Resolver::Shard& Resolver::shard_of(const std::string& domain) {
+    return shards_[std::hash<std::string> {}(domain) % SHARDS];
+}
+
+void Resolver::store(Shard& shard, const std::string& domain, const Resolution& resolution) {
+    auto now = Clock::now();
+    if (shard.entries.size() >= SHARD_SWEEP_SIZE) {
+        for (auto iter = shard.entries.begin(); iter != shard.entries.end();) {
+            if (!iter->second.resolving && iter->second.expiry <= now) {
+                iter = shard.entries.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+    auto expiry = now + (resolution.index() == 0 ? cache_ttl_ : failure_ttl_);
+    auto& entry = shard.entries[domain];
+    entry.resolution = resolution;
+    entry.expiry = expiry;
+    entry.resolving = false;
+}
+
+void Resolver::exec() {
+    while (true) {
+        std::string domain {};
+        {
+            std::unique_lock<std::mutex> lck { jobs_mtx_ };
+            jobs_cv_.wait(lck, [this]() { return stopped_ || !jobs_.empty(); });
+            if (stopped_) {
+                return;
+            }
+            domain = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        complete(domain, lookup_(domain));
+    }
+}
+
+void Resolver::complete(const std::string& domain, const Resolution& resolution) {
+    std::vector<Callback> waiters {};
+    {
+        auto& shard = shard_of(domain);
+        std::unique_lock<std::mutex> lck { shard.mtx };
+        auto find = shard.entries.find(domain);
+        if (find != shard.entries.end()) {
+            waiters.swap(find.value().waiters);
+        }
+        store(shard, domain, resolution);
+    }
+    for (auto& waiter : waiters) {
+        waiter(resolution);
+    }
+}
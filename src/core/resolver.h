@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "tsl/robin_map.h"
+
+#include "spinet/core/address.h"
+
+namespace spinet {
+
+// Resolves the domains on its own threads and caches the results for a while. A lookup of a domain which is
+// being resolved waits for the same result instead of asking again.
+class Resolver {
+    public:
+    // the addresses carry no port, or the reason of the failure
+    using Resolution = std::variant<std::vector<Address>, std::string>;
+    using Callback = std::function<void(const Resolution&)>;
+    using Lookup = std::function<Resolution(const std::string&)>;
+
+    using Clock = std::chrono::steady_clock;
+    // getaddrinfo reports no ttl, so a result is kept for a fixed time
+    static constexpr Clock::duration CACHE_TTL = std::chrono::seconds { 30 };
+    static constexpr Clock::duration FAILURE_TTL = std::chrono::seconds { 5 };
+    static constexpr std::size_t SHARDS = 16;
+    // the expired entries of a shard are swept when it grows beyond it
+    static constexpr std::size_t SHARD_SWEEP_SIZE = 1024;
+    static constexpr std::size_t THREADS = 2;
+
+    static Resolver& instance();
+
+    // a resolver of its own rather than the shared instance, with the lookup and the ttls given
+    Resolver(Lookup lookup, Clock::duration cache_ttl, Clock::duration failure_ttl);
+    // the lookups still waiting for a thread complete with a failure
+    ~Resolver();
+
+    // resolve on the calling thread if the domain is not cached
+    Resolution resolve(const std::string& domain);
+    // the callback runs on the calling thread if the domain is cached, otherwise on a resolver thread.
+    // Address::async_resolve posts it back to the runtime of the caller
+    void async_resolve(const std::string& domain, Callback callback);
+
+    private:
+    struct Entry {
+        Resolution resolution;
+        Clock::time_point expiry;
+        bool resolving;
+        std::vector<Callback> waiters;
+    };
+
+    struct Shard {
+        std::mutex mtx;
+        tsl::robin_map<std::string, Entry> entries;
+    };
+
+    Resolver();
+
+    Resolver(Resolver&& other) = delete;
+    Resolver& operator=(Resolver&& other) = delete;
+    Resolver(const Resolver& other) = delete;
+    Resolver& operator=(const Resolver& other) = delete;
+
+    static Resolution lookup(const std::string& domain);
+
+    Shard& shard_of(const std::string& domain);
+    // the caller holds the lock of the shard
+    void store(Shard& shard, const std::string& domain, const Resolution& resolution);
+    void exec();
+    void complete(const std::string& domain, const Resolution& resolution);
+
+    Lookup lookup_;
+    Clock::duration cache_ttl_;
+    Clock::duration failure_ttl_;
+    Shard shards_[SHARDS];
+
+    std::mutex jobs_mtx_;
+    std::condition_variable jobs_cv_;
+    std::deque<std::string> jobs_; // the domains waiting for a resolver thread
+    bool stopped_;
+    std::vector<std::thread> threads_;
+};
+
+}
@@ -1,26 +1,71 @@
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 
+#include "pthread.h"
+#include "sched.h"
 #include "sys/epoll.h"
+#include "sys/eventfd.h"
+#include "sys/timerfd.h"
 #include "unistd.h"
 
 #include "runtime.h"
+#include "util.h"
 
 using namespace spinet;
 
 constexpr uint32_t EPOLL_WAIT_SIZE = 128;
 
-Runtime::Runtime()
+static thread_local Runtime* current_runtime = nullptr;
+
+Runtime::Runtime(Backend backend)
 : running_ { false }
-, stopped_ { true } {
-    epoll_fd_ = ::epoll_create(1); // the arg of epoll_create is deprecated
+, stopped_ { true }
+, runtime_thread_id_ {}
+, cpus_ {}
+, thread_name_ {}
+, numa_node_ { -1 }
+, poller_ { Poller::create(backend) }
+, pool_ { std::make_shared<SlabPool>() }
+, load_ { std::make_shared<RuntimeLoad>() }
+, spare_buffers_ {} {
+    wakeup_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    poller_->add(wakeup_fd_, nullptr, EPOLLIN); // no handle is bound to the wakeup fd
+    timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    poller_->add(timer_fd_, this, EPOLLIN); // the runtime itself is bound to the timer fd
+    timers_ = std::make_shared<TimerScheduler>([this]() {
+        // the runtime thread rearms the timer fd at the end of each iteration
+        if (!in_runtime_thread()) {
+            wakeup();
+        }
+    });
 }
 
 Runtime::~Runtime() {
     stop();
     while (running_) {
     }
-    ::close(epoll_fd_);
+    timers_->clear();
+    poller_->remove(timer_fd_);
+    ::close(timer_fd_);
+    poller_->remove(wakeup_fd_);
+    ::close(wakeup_fd_);
+}
+
+void Runtime::set_cpu_affinity(std::vector<int> cpus) {
+    std::unique_lock<std::mutex> lck { thread_mtx_ };
+    cpus_ = std::move(cpus);
+}
+
+void Runtime::set_thread_name(std::string name) {
+    std::unique_lock<std::mutex> lck { thread_mtx_ };
+    thread_name_ = std::move(name);
+}
+
+void Runtime::bind_numa_node(int node) {
+    std::unique_lock<std::mutex> lck { thread_mtx_ };
+    numa_node_ = node;
+    pool_->bind_to_node(node);
 }
 
 std::optional<std::string> Runtime::run() {
@@ -33,6 +78,7 @@ std::optional<std::string> Runtime::run() {
     if (runtime_thread_.joinable()) {
         runtime_thread_.join();
     }
+    stopped_ = false;
     runtime_thread_ = std::thread { &Runtime::exec, this };
     return {};
 }
@@ -40,6 +86,7 @@ std::optional<std::string> Runtime::run() {
 void Runtime::stop() {
     if (running_) {
         stopped_ = true;
+        wakeup();
         std::unique_lock<std::mutex> lck { thread_mtx_ };
         if (runtime_thread_.joinable()) {
             runtime_thread_.join();
@@ -52,28 +99,42 @@ bool Runtime::is_running() {
 }
 
 std::size_t Runtime::current_load() {
-    std::unique_lock<std::mutex> lck { handles_mtx_ };
-    return all_handles_.size();
+    return load_->handles.load(std::memory_order_relaxed);
+}
+
+std::size_t Runtime::pending_bytes() {
+    return load_->pending_bytes.load(std::memory_order_relaxed);
+}
+
+const std::shared_ptr<RuntimeLoad>& Runtime::load() {
+    return load_;
 }
 
 void Runtime::register_handle(const std::shared_ptr<Handle>& handle) {
+    std::unique_lock<std::mutex> handles_lck { handles_mtx_ };
+    bool idle = pending_handles_.empty();
+    insert_handle(handle);
+    if (idle && !in_runtime_thread()) {
+        wakeup();
+    }
+}
+
+void Runtime::insert_handle(const std::shared_ptr<Handle>& handle) {
     Handle* raw_handle = handle.get();
     raw_handle->runtime_ = weak_from_this();
+    raw_handle->load_ = load_;
     int handle_fd = raw_handle->fd_;
-    ::epoll_event ev { 0, { 0 } };
-    ev.data.ptr = raw_handle;
-    std::unique_lock<std::mutex> handles_lck { handles_mtx_ };
+    uint32_t events = raw_handle->interest_events();
+    // the tasks queued before the registration are dispatched on the next iteration
+    pending_handles_.insert(raw_handle);
     auto prev = all_handles_.find(handle_fd);
     if (prev == all_handles_.end()) {
-        // insert
-        if (auto socket = dynamic_cast<BaseSocket*>(raw_handle)) {
-            ev.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET | EPOLLRDHUP;
-            all_sockets_.insert(socket);
-        } else {
-            ev.events = EPOLLIN | EPOLLRDHUP;
+        // insert, a listener is accepted by the poller itself when the backend can
+        if (!raw_handle->is_listener() || !poller_->add_listener(handle_fd, raw_handle)) {
+            poller_->add(handle_fd, raw_handle, events);
         }
-        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, handle_fd, &ev);
         all_handles_.insert({ handle_fd, handle });
+        load_->handles.fetch_add(1, std::memory_order_relaxed);
     } else {
         // pre-remove and close the old handle for the special situation
         auto prev_handle = prev->second;
@@ -81,17 +142,9 @@ void Runtime::register_handle(const std::shared_ptr<Handle>& handle) {
         Handle* prev_raw_handle = prev_handle.get();
         prev_raw_handle->runtime_.reset(); // prevent the recursive call for deregister_handle
         prev_raw_handle->close();
-        if (auto socket = dynamic_cast<BaseSocket*>(prev_raw_handle)) {
-            all_sockets_.erase(socket);
-        }
+        pending_handles_.erase(prev_raw_handle);
         // update
-        if (auto socket = dynamic_cast<BaseSocket*>(raw_handle)) {
-            ev.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET | EPOLLRDHUP;
-            all_sockets_.insert(socket);
-        } else {
-            ev.events = EPOLLIN | EPOLLRDHUP;
-        }
-        ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, handle_fd, &ev);
+        poller_->modify(handle_fd, raw_handle, events);
         prev.value() = handle;
     }
 }
@@ -103,93 +156,223 @@ void Runtime::deregister_handle(Handle* handle) {
     if (find == all_handles_.end() || find->second.get() != handle) {
         return;
     }
-    // pre-remove the old handle and delete the epoll_event
+    // pre-remove the old handle and stop polling its fd
     handle->runtime_.reset(); // prevent the recursive call for deregister_handle
-    ::epoll_event ev { 0, { 0 } };
-    ev.data.ptr = handle;
-    if (auto socket = dynamic_cast<BaseSocket*>(handle)) {
-        ev.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET | EPOLLRDHUP;
-        all_sockets_.erase(socket);
-    } else {
-        ev.events = EPOLLIN | EPOLLRDHUP;
-    }
-    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, handle_fd, &ev);
+    pending_handles_.erase(handle);
+    poller_->remove(handle_fd);
     removable_handles_.push_back(find->second);
     all_handles_.erase(find);
+    load_->handles.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void Runtime::schedule(Handle* handle) {
+    std::unique_lock<std::mutex> lck { handles_mtx_ };
+    auto find = all_handles_.find(handle->fd_);
+    if (find == all_handles_.end() || find->second.get() != handle) {
+        return;
+    }
+    bool idle = pending_handles_.empty();
+    pending_handles_.insert(handle);
+    // the runtime drains the pending handles before blocking, so only the first one needs to wake it up
+    if (idle && !in_runtime_thread()) {
+        wakeup();
+    }
+}
+
+void Runtime::post(std::function<void()> task) {
+    std::unique_lock<std::mutex> lck { handles_mtx_ };
+    if (!running_ || stopped_) {
+        // nothing is consuming on the runtime thread any more
+        lck.unlock();
+        task();
+        return;
+    }
+    bool idle = pending_handles_.empty() && posted_tasks_.empty();
+    posted_tasks_.push_back(std::move(task));
+    if (idle && !in_runtime_thread()) {
+        wakeup();
+    }
+}
+
+bool Runtime::in_runtime_thread() {
+    return runtime_thread_id_.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+Runtime* Runtime::current() {
+    return current_runtime;
+}
+
+Backend Runtime::backend() {
+    return poller_->backend();
+}
+
+const std::shared_ptr<SlabPool>& Runtime::pool() {
+    return pool_;
+}
+
+Buffer Runtime::provide_buffer() {
+    if (!spare_buffers_.empty()) {
+        auto buffer = std::move(spare_buffers_.back());
+        spare_buffers_.pop_back();
+        return buffer;
+    }
+    return Buffer::allocate(PROVIDED_BUFFER_SIZE, pool_);
+}
+
+void Runtime::recycle_buffer(Buffer buffer) {
+    if (buffer.size() == PROVIDED_BUFFER_SIZE && spare_buffers_.size() < SPARE_BUFFERS_CAPACITY) {
+        spare_buffers_.push_back(std::move(buffer));
+    }
+}
+
+Buffer Runtime::hand_over(Buffer buffer, std::size_t size) {
+    if (size == 0 || size > SMALL_READ_SIZE) {
+        return buffer.slice(0, size);
+    }
+    auto copy = Buffer::allocate(size, pool_);
+    std::memcpy(copy.data(), buffer.data(), size);
+    recycle_buffer(std::move(buffer));
+    return copy;
+}
+
+const std::shared_ptr<TimerScheduler>& Runtime::timers() {
+    return timers_;
+}
+
+void Runtime::wakeup() {
+    uint64_t value { 1 };
+    [[maybe_unused]] auto res = ::write(wakeup_fd_, &value, sizeof(value));
 }
 
 void Runtime::exec() {
-    stopped_ = false;
-    ::epoll_event events[EPOLL_WAIT_SIZE];
+    runtime_thread_id_ = std::this_thread::get_id();
+    current_runtime = this;
+    apply_placement();
+    Poller::Event events[EPOLL_WAIT_SIZE];
+    bool idle = false;
     while (!stopped_) {
-        int event_size = ::epoll_wait(epoll_fd_, events, EPOLL_WAIT_SIZE, 1);
+        // block until an event arrives, unless some handles are still waiting to be dispatched
+        int event_size = poller_->wait(events, EPOLL_WAIT_SIZE, idle ? -1 : 0);
         for (int i = 0; i < event_size; i++) {
-            ::epoll_event& ev = events[i];
-            Handle* handle = static_cast<Handle*>(ev.data.ptr);
-            if (BaseAcceptor* acceptor = dynamic_cast<BaseAcceptor*>(handle)) {
-                if (ev.events & EPOLLIN) {
-                    acceptor->do_accept();
-                } else {
-                    acceptor->close();
-                }
+            Poller::Event& ev = events[i];
+            if (ev.data == nullptr) {
+                uint64_t value {};
+                [[maybe_unused]] auto res = ::read(wakeup_fd_, &value, sizeof(value));
                 continue;
             }
-            if (BaseSocket* socket = dynamic_cast<BaseSocket*>(handle)) {
-                if (ev.events & (EPOLLIN | EPOLLPRI)) {
-                    socket->do_read();
-                } else if (ev.events & EPOLLOUT) {
-                    socket->do_write();
-                } else {
-                    socket->close();
-                }
+            if (ev.data == this) {
+                uint64_t value {};
+                [[maybe_unused]] auto res = ::read(timer_fd_, &value, sizeof(value));
+                armed_expiry_.reset(); // the timer fd has fired, so it must be armed again
                 continue;
             }
-        }
-        {
-            Set<BaseSocket*> all_sockets_copy {};
-            {
-                std::unique_lock<std::mutex> lck { handles_mtx_ };
-                all_sockets_copy = all_sockets_;
-            }
-            for (auto socket : all_sockets_copy) {
-                socket->do_read();
-                socket->do_write();
+            if (ev.accepted_fd >= 0) {
+                static_cast<Handle*>(ev.data)->on_accepted(ev.accepted_fd);
+                continue;
             }
+            static_cast<Handle*>(ev.data)->on_events(ev.events);
         }
+        timers_->expire(TimerScheduler::Clock::now());
+        run_posted_tasks();
+        dispatch_pending_handles();
         {
+            std::vector<std::shared_ptr<Handle>> removed {};
             std::unique_lock<std::mutex> lck { handles_mtx_ };
-            removable_handles_.clear();
+            removable_handles_.swap(removed);
+            idle = pending_handles_.empty() && posted_tasks_.empty();
+            lck.unlock(); // the removed handles are destroyed without the lock
         }
+        rearm_timer();
     }
     // clear the resources left
+    run_posted_tasks();
     release_all_handles();
+    runtime_thread_id_ = std::thread::id {};
+    current_runtime = nullptr;
     running_ = false;
 }
 
-void Runtime::release_all_handles() {
-    std::unique_lock<std::mutex> lck { handles_mtx_ };
-    for (auto& [fd, handle] : all_handles_) {
-        handle->runtime_.reset();
-        ::epoll_event ev { 0, { 0 } };
-        auto ptr = handle.get();
-        ev.data.ptr = ptr;
-        if (dynamic_cast<BaseSocket*>(ptr)) {
-            ev.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET | EPOLLRDHUP;
-        } else {
-            ev.events = EPOLLIN | EPOLLRDHUP;
+void Runtime::apply_placement() {
+    // a failure only loses the locality, so the runtime keeps running anyway
+    if (!cpus_.empty()) {
+        ::cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : cpus_) {
+            CPU_SET(cpu, &cpus);
         }
-        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &ev);
+        ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus);
+    }
+    if (!thread_name_.empty()) {
+        // the name of a thread is limited to 15 characters
+        ::pthread_setname_np(::pthread_self(), thread_name_.substr(0, 15).c_str());
     }
+    if (numa_node_ >= 0) {
+        prefer_numa_node(numa_node_);
+    }
+}
+
+void Runtime::dispatch_pending_handles() {
+    // a socket whose task stopped at EAGAIN is left to its next edge-triggered event,
+    // so only the handles which have queued new tasks since the last iteration are visited here.
     {
-        Map<int, std::shared_ptr<Handle>> cleanup {};
-        all_handles_.swap(cleanup);
+        std::unique_lock<std::mutex> lck { handles_mtx_ };
+        if (pending_handles_.empty()) {
+            return;
+        }
+        dispatching_handles_.swap(pending_handles_);
+    }
+    for (auto handle : dispatching_handles_) {
+        handle->on_events(EPOLLIN | EPOLLOUT);
     }
+    dispatching_handles_.clear(); // the buckets are kept for the next swap
+}
+
+void Runtime::run_posted_tasks() {
     {
-        Set<BaseSocket*> cleanup {};
-        all_sockets_.swap(cleanup);
+        std::unique_lock<std::mutex> lck { handles_mtx_ };
+        if (posted_tasks_.empty()) {
+            return;
+        }
+        running_tasks_.swap(posted_tasks_);
     }
+    for (auto& task : running_tasks_) {
+        task();
+    }
+    running_tasks_.clear(); // the capacity is kept for the next swap
+}
+
+void Runtime::release_all_handles() {
+    // the handles are destroyed after the lock is dropped, since a destructor may run a callback which calls back
+    // into the runtime, such as a connector cancelled with ECANCELED
+    Map<int, std::shared_ptr<Handle>> released {};
+    std::vector<std::shared_ptr<Handle>> removed {};
     {
-        std::vector<std::shared_ptr<Handle>> cleanup {};
-        removable_handles_.swap(cleanup);
+        std::unique_lock<std::mutex> lck { handles_mtx_ };
+        for (auto& [fd, handle] : all_handles_) {
+            handle->runtime_.reset();
+            poller_->remove(fd);
+        }
+        all_handles_.swap(released);
+        load_->handles.store(0, std::memory_order_relaxed);
+        Set<Handle*> cleanup {};
+        pending_handles_.swap(cleanup);
+        removable_handles_.swap(removed);
+    }
+}
+
+void Runtime::rearm_timer() {
+    auto next = timers_->next_expiry();
+    if (next == armed_expiry_) {
+        return;
+    }
+    armed_expiry_ = next;
+    ::itimerspec spec {};
+    if (next) {
+        // steady_clock is CLOCK_MONOTONIC, the zero value would disarm the timer fd
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(next->time_since_epoch()).count();
+        nanoseconds = std::max<int64_t>(nanoseconds, 1);
+        spec.it_value.tv_sec = nanoseconds / 1000000000;
+        spec.it_value.tv_nsec = nanoseconds % 1000000000;
     }
+    ::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
 }
\ No newline at end of file
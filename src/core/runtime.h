@@ -12,39 +12,125 @@
 #include "tsl/robin_map.h"
 #include "tsl/robin_set.h"
 
+#include "spinet/core/backend.h"
+#include "spinet/core/buffer.h"
 #include "spinet/core/handle.h"
+#include "spinet/core/timing_wheel.h"
+
+#include "poller.h"
+#include "slab_pool.h"
 
 namespace spinet {
 
+// the load of a runtime, which is read without any lock to place the new connections
+struct RuntimeLoad {
+    std::atomic<std::size_t> handles { 0 };
+    std::atomic<std::size_t> pending_bytes { 0 }; // the bytes queued by the writes of its sockets
+    std::atomic<std::size_t> connections { 0 }; // the accepted sockets which are not closed yet
+};
+
 class Runtime : public std::enable_shared_from_this<Runtime> {
     public:
-    Runtime();
+    static constexpr std::size_t PROVIDED_BUFFER_SIZE = 16 * 1024;
+    // the recycled buffers kept for the next reads, beyond which they go back to the pool
+    static constexpr std::size_t SPARE_BUFFERS_CAPACITY = 8;
+    // a read of up to this many bytes is copied out of its provided buffer, so it does not pin the whole buffer
+    static constexpr std::size_t SMALL_READ_SIZE = PROVIDED_BUFFER_SIZE / 4;
+
+    Runtime(Backend backend = Backend::EPOLL);
     ~Runtime();
+    // the placement of the runtime thread, which is applied when it starts
+    void set_cpu_affinity(std::vector<int> cpus);
+    void set_thread_name(std::string name);
+    // allocate the sockets, the buffers and the other memory touched by the runtime thread on the numa node
+    void bind_numa_node(int node);
     std::optional<std::string> run();
     void stop();
     bool is_running();
+    // the number of the registered handles
     std::size_t current_load();
+    std::size_t pending_bytes();
+    // the counters of the runtime, which may outlive it
+    const std::shared_ptr<RuntimeLoad>& load();
     void register_handle(const std::shared_ptr<Handle> &handle);
+    // register a batch under one lock, and wake the runtime up at most once
+    template <typename T> void register_handles(const std::vector<std::shared_ptr<T>>& handles) {
+        if (handles.empty()) {
+            return;
+        }
+        std::unique_lock<std::mutex> handles_lck { handles_mtx_ };
+        bool idle = pending_handles_.empty();
+        for (auto& handle : handles) {
+            insert_handle(handle);
+        }
+        if (idle && !in_runtime_thread()) {
+            wakeup();
+        }
+    }
     void deregister_handle(Handle* handle);
+    void schedule(Handle* handle);
+    void post(std::function<void()> task);
+    bool in_runtime_thread();
+    // the runtime running on the calling thread, or null
+    static Runtime* current();
+    Backend backend();
+    // the objects bound to this runtime are allocated from it
+    const std::shared_ptr<SlabPool>& pool();
+    template <typename T, typename... Args> std::shared_ptr<T> make_pooled(Args&&... args) {
+        return std::allocate_shared<T>(PoolAllocator<T> { pool_ }, std::forward<Args>(args)...);
+    }
+    // a read buffer lent to a socket only when its data arrives, so an idle connection holds none.
+    // these are only called on the runtime thread
+    Buffer provide_buffer();
+    // take back a provided buffer which has received no byte
+    void recycle_buffer(Buffer buffer);
+    // the filled part of a provided buffer handed to the reader. a small read is copied into a buffer of its size,
+    // and the provided buffer is recycled
+    Buffer hand_over(Buffer buffer, std::size_t size);
+    // the timers expire on the runtime thread
+    const std::shared_ptr<TimerScheduler>& timers();
 
     private:
     template <typename K, typename V> using Map = tsl::robin_map<K, V>;
     template <typename E> using Set = tsl::robin_set<E>;
 
     void exec();
+    void apply_placement();
+
+    // the caller holds handles_mtx_
+    void insert_handle(const std::shared_ptr<Handle>& handle);
 
+    void wakeup();
+    void dispatch_pending_handles();
+    void run_posted_tasks();
     void release_all_handles();
+    void rearm_timer();
 
     std::atomic<bool> running_;
     std::atomic<bool> stopped_;
     std::mutex thread_mtx_;
     std::thread runtime_thread_;
+    std::atomic<std::thread::id> runtime_thread_id_;
+    std::vector<int> cpus_; // empty if the thread is not pinned
+    std::string thread_name_;
+    int numa_node_; // -1 if the memory is not bound
 
-    int epoll_fd_;
+    std::unique_ptr<Poller> poller_;
+    std::shared_ptr<SlabPool> pool_;
+    std::shared_ptr<RuntimeLoad> load_;
+    std::vector<Buffer> spare_buffers_; // the recycled buffers, reused by the next reads without touching the pool
+    int wakeup_fd_; // an eventfd which interrupts the blocking wait of the poller
+    int timer_fd_; // a timerfd armed at the next expiry of the timers
+    std::optional<TimerScheduler::TimePoint> armed_expiry_; // only touched by the runtime thread
+    std::shared_ptr<TimerScheduler> timers_;
 
     std::mutex handles_mtx_;
     std::vector<std::shared_ptr<Handle>> removable_handles_;
-    Set<BaseSocket*> all_sockets_;
+    Set<Handle*> pending_handles_; // handles with newly queued tasks, dispatched on the next iteration
+    std::vector<std::function<void()>> posted_tasks_; // closures which must run on the runtime thread
+    // swapped with the two above on the runtime thread, so their storage is reused across iterations
+    Set<Handle*> dispatching_handles_;
+    std::vector<std::function<void()>> running_tasks_;
     Map<int, std::shared_ptr<Handle>> all_handles_;
 };
 
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#include "slab_pool.h"
+#include "util.h"
+
+using namespace spinet;
+
+static std::size_t size_class(std::size_t size) {
+    // an empty request still takes the smallest block, which is distinct from every other allocation
+    return std::max<std::size_t>((size + SlabPool::BLOCK_ALIGNMENT - 1) / SlabPool::BLOCK_ALIGNMENT, 1);
+}
+
+SlabPool::SlabPool()
+: free_lists_(size_class(MAX_BLOCK_SIZE) + 1, nullptr)
+, slab_alignment_ { BLOCK_ALIGNMENT }
+, node_ { -1 } {
+}
+
+SlabPool::~SlabPool() {
+    for (auto slab : slabs_) {
+        ::operator delete(slab, std::align_val_t { slab_alignment_ });
+    }
+}
+
+void SlabPool::bind_to_node(int node) {
+    std::unique_lock<std::mutex> lck { mtx_ };
+    if (!slabs_.empty() || node < 0) {
+        return;
+    }
+    node_ = node;
+    slab_alignment_ = std::max<std::size_t>(::sysconf(_SC_PAGESIZE), BLOCK_ALIGNMENT);
+}
+
+void* SlabPool::allocate(std::size_t size) {
+    if (size > MAX_BLOCK_SIZE) {
+        return ::operator new(size, std::align_val_t { BLOCK_ALIGNMENT });
+    }
+    std::size_t index = size_class(size);
+    std::unique_lock<std::mutex> lck { mtx_ };
+    FreeBlock* block = free_lists_[index];
+    if (block == nullptr) {
+        // carve a new slab into blocks of this size class
+        std::size_t block_size = index * BLOCK_ALIGNMENT;
+        std::size_t slab_size = (block_size * BLOCKS_PER_SLAB + slab_alignment_ - 1) / slab_alignment_ * slab_alignment_;
+        auto slab = static_cast<uint8_t*>(::operator new(slab_size, std::align_val_t { slab_alignment_ }));
+        if (node_ >= 0) {
+            prefer_numa_node(slab, slab_size, node_);
+        }
+        slabs_.push_back(slab);
+        for (std::size_t i = 0; i < slab_size / block_size; i++) {
+            auto free_block = reinterpret_cast<FreeBlock*>(slab + i * block_size);
+            free_block->next = block;
+            block = free_block;
+        }
+    }
+    free_lists_[index] = block->next;
+    return block;
+}
+
+void SlabPool::deallocate(void* block, std::size_t size) {
+    if (size > MAX_BLOCK_SIZE) {
+        ::operator delete(block, std::align_val_t { BLOCK_ALIGNMENT });
+        return;
+    }
+    std::size_t index = size_class(size);
+    std::unique_lock<std::mutex> lck { mtx_ };
+    auto free_block = static_cast<FreeBlock*>(block);
+    free_block->next = free_lists_[index];
+    free_lists_[index] = free_block;
+}
\ No newline at end of file
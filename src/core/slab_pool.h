@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "spinet/core/task_queue.h"
+
+namespace spinet {
+
+// A pool of blocks carved from large slabs and grouped by size classes. The freed blocks are kept for reuse,
+// so the objects of the same type are recycled without touching the global allocator in the steady state.
+class SlabPool {
+    public:
+    // every block is aligned to a cache line, so no two objects share one
+    static constexpr std::size_t BLOCK_ALIGNMENT = CACHE_LINE_SIZE;
+    static constexpr std::size_t BLOCKS_PER_SLAB = 32;
+    // the larger requests are forwarded to the global allocator
+    static constexpr std::size_t MAX_BLOCK_SIZE = 64 * 1024;
+
+    SlabPool();
+    ~SlabPool();
+
+    // place the slabs on the numa node, it must be called before the first allocation
+    void bind_to_node(int node);
+    // a size of zero is served by the smallest block
+    void* allocate(std::size_t size);
+    // the size must be the same as the allocation
+    void deallocate(void* block, std::size_t size);
+
+    private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    SlabPool(SlabPool&& other) = delete;
+    SlabPool& operator=(SlabPool&& other) = delete;
+    SlabPool(const SlabPool& other) = delete;
+    SlabPool& operator=(const SlabPool& other) = delete;
+
+    // blocks may be freed on any thread, since the last reference of an object can be dropped anywhere
+    std::mutex mtx_;
+    std::vector<FreeBlock*> free_lists_; // indexed by the size class
+    std::vector<void*> slabs_;
+    std::size_t slab_alignment_; // a page if the slabs are bound to a node, so that the binding covers whole pages
+    int node_; // -1 if the slabs are not bound
+};
+
+// An allocator drawing from a SlabPool, which keeps the pool alive until every object allocated from it is freed.
+template <typename T> class PoolAllocator {
+    public:
+    using value_type = T;
+
+    explicit PoolAllocator(std::shared_ptr<SlabPool> pool)
+    : pool_ { std::move(pool) } {
+    }
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other)
+    : pool_ { other.pool_ } {
+    }
+
+    T* allocate(std::size_t n) {
+        static_assert(alignof(T) <= SlabPool::BLOCK_ALIGNMENT, "the alignment is not supported by the pool");
+        return static_cast<T*>(pool_->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, std::size_t n) {
+        pool_->deallocate(ptr, n * sizeof(T));
+    }
+
+    template <typename U> bool operator==(const PoolAllocator<U>& other) const {
+        return pool_ == other.pool_;
+    }
+
+    template <typename U> bool operator!=(const PoolAllocator<U>& other) const {
+        return pool_ != other.pool_;
+    }
+
+    private:
+    template <typename U> friend class PoolAllocator;
+
+    std::shared_ptr<SlabPool> pool_;
+};
+
+}
\ No newline at end of file
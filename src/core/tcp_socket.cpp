@@ -1,4 +1,10 @@
+#include <algorithm>
+
 #include "errno.h"
+#include "linux/errqueue.h"
+#include "netinet/in.h"
+#include "poll.h"
+#include "sys/epoll.h"
 #include "sys/socket.h"
 #include "unistd.h"
 
@@ -8,240 +14,746 @@
 
 namespace spinet {
 
-enum TaskStrategy { TRY, UNTIL_FINISHED };
-
-class TcpReadTask {
+// Waits for the drained pipe of a splice to be refilled or closed, then serves the socket again. The pipe belongs
+// to the caller, so it is only deregistered and never closed.
+class PipeWatcher : public Handle {
     public:
-    TcpReadTask(uint8_t* buf, std::size_t size, spinet::TaskStrategy strategy)
-    : finished_ { false }
-    , buf_ { buf }
-    , size_ { size }
-    , pos_ { 0 }
-    , strategy_ { strategy } {
+    PipeWatcher(int fd, std::weak_ptr<Handle> socket)
+    : socket_ { std::move(socket) } {
+        fd_ = fd;
     }
 
-    std::optional<int> exec(int fd) {
-        if (finished_) {
-            return {};
-        }
-        ssize_t bytes = ::recv(fd, buf_ + pos_, size_ - pos_, MSG_NOSIGNAL);
-        if (bytes <= 0) {
-            if (bytes == 0) {
-                return EBADF;
-            } else {
-                return errno;
-            }
-        }
-        pos_ = pos_ + bytes;
-        if (strategy_ == TaskStrategy::TRY) {
-            finished_ = true;
-        } else { // the alternative is UNTIL_FINISHED
-            if (pos_ == size_) {
-                finished_ = true;
-            }
+    void close() override {
+        if (auto runtime = runtime_.lock()) {
+            runtime->deregister_handle(this);
         }
-        return {};
     }
 
-    bool finished() {
-        return finished_;
+    protected:
+    uint32_t interest_events() override {
+        return EPOLLIN | EPOLLET | EPOLLRDHUP;
     }
 
-    std::size_t finished_size() {
-        return pos_;
-    }
-
-    private:
-    bool finished_;
-    uint8_t* buf_;
-    std::size_t size_;
-    std::size_t pos_;
-    spinet::TaskStrategy strategy_;
-};
-
-class TcpWriteTask {
-    public:
-    TcpWriteTask(uint8_t* buf, std::size_t size, spinet::TaskStrategy strategy)
-    : finished_ { false }
-    , buf_ { buf }
-    , size_ { size }
-    , pos_ { 0 }
-    , strategy_ { strategy } {
-    }
-
-    std::optional<int> exec(int fd) {
-        if (finished_) {
-            return {};
+    void on_events(uint32_t) override {
+        // the runtime also dispatches a new handle once without any event, so the pipe is checked by itself
+        ::pollfd pfd { fd_, POLLIN, 0 };
+        if (::poll(&pfd, 1, 0) != 1) {
+            return;
         }
-        ssize_t bytes = ::send(fd, buf_ + pos_, size_ - pos_, MSG_NOSIGNAL);
-        if (bytes <= 0) {
-            if (bytes == 0) {
-                return EBADF;
-            } else {
-                return errno;
-            }
+        auto runtime = runtime_.lock();
+        close();
+        auto socket = socket_.lock();
+        if (runtime && socket) {
+            runtime->schedule(socket.get());
         }
-        pos_ = pos_ + bytes;
-        if (strategy_ == TaskStrategy::TRY) {
-            finished_ = true;
-        } else { // the alternative is UNTIL_FINISHED
-            if (pos_ == size_) {
-                finished_ = true;
-            }
-        }
-        return {};
-    }
-
-    bool finished() {
-        return finished_;
-    }
-
-    std::size_t finished_size() {
-        return pos_;
     }
 
     private:
-    bool finished_;
-    uint8_t* buf_;
-    std::size_t size_;
-    std::size_t pos_;
-    spinet::TaskStrategy strategy_;
+    std::weak_ptr<Handle> socket_;
 };
 
 }
 
 using namespace spinet;
 
+constexpr std::size_t DEFAULT_IO_BUDGET = 256 * 1024;
+constexpr std::size_t MAX_GATHERED_IOVECS = 64;
+
 TcpSocket::TcpSocket(int fd, const Address& peer)
 : closed_ { false }
-, peer_ { peer } {
+, peer_closed_ { false }
+, producers_ { 0 }
+, io_budget_ { DEFAULT_IO_BUDGET }
+, inline_completion_ { false }
+, queue_epoch_ { 0 }
+, reading_ { false }
+, writing_ { false }
+, timers_ {}
+, idle_timeout_ { 0 }
+, last_active_ { TimerScheduler::Clock::now() }
+, read_deadline_timer_ { this, &TcpSocket::on_read_deadline }
+, write_deadline_timer_ { this, &TcpSocket::on_write_deadline }
+, idle_timer_ { this, &TcpSocket::on_idle_deadline }
+, zerocopy_threshold_ { 0 }
+, zerocopy_state_ { ZEROCOPY_UNKNOWN }
+, zerocopy_next_id_ { 0 }
+, zerocopy_released_id_ { 0 }
+, zerocopy_completions_ {}
+, pipe_watcher_ {}
+, peer_ { peer }
+, connection_load_ {} {
     fd_ = fd;
 }
 
 TcpSocket::~TcpSocket() {
     close();
+    // a timer may have been armed by the runtime thread while the socket was being closed,
+    // or left behind by a stopped runtime
+    cancel_timers(timers_.lock());
+}
+
+bool TcpSocket::async_read(uint8_t* buf, std::size_t size, ReadCallback callback, Duration timeout) {
+    return submit(read_task_queue_, TcpReadTask { buf, size, TaskStrategy::UNTIL_FINISHED }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_read_some(uint8_t* buf, std::size_t size, ReadCallback callback, Duration timeout) {
+    return submit(read_task_queue_, TcpReadTask { buf, size, TaskStrategy::TRY }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_write(uint8_t* buf, std::size_t size, WriteCallback callback, Duration timeout) {
+    return submit(write_task_queue_, TcpWriteTask { buf, size, TaskStrategy::UNTIL_FINISHED }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_write_some(uint8_t* buf, std::size_t size, WriteCallback callback, Duration timeout) {
+    return submit(write_task_queue_, TcpWriteTask { buf, size, TaskStrategy::TRY }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_readv(const ::iovec* iov, std::size_t count, ReadCallback callback, Duration timeout) {
+    return submit(read_task_queue_, TcpReadTask { iov, count, TaskStrategy::UNTIL_FINISHED }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_writev(const ::iovec* iov, std::size_t count, WriteCallback callback, Duration timeout) {
+    return submit(write_task_queue_, TcpWriteTask { iov, count, TaskStrategy::UNTIL_FINISHED }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_read(std::size_t size, BufferReadCallback callback, Duration timeout) {
+    auto task = TcpReadTask { allocate_buffer(size), TaskStrategy::UNTIL_FINISHED };
+    return submit(read_task_queue_, std::move(task), std::move(callback), timeout);
+}
+
+bool TcpSocket::async_read_some(std::size_t size, BufferReadCallback callback, Duration timeout) {
+    return submit(read_task_queue_, TcpReadTask { allocate_buffer(size), TaskStrategy::TRY }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_read_some(BufferReadCallback callback, Duration timeout) {
+    return submit(read_task_queue_, TcpReadTask { TaskStrategy::TRY }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_write(Buffer buffer, WriteCallback callback, Duration timeout) {
+    return submit(write_task_queue_, TcpWriteTask { std::move(buffer), TaskStrategy::UNTIL_FINISHED }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_write(BufferChain chain, WriteCallback callback, Duration timeout) {
+    return submit(write_task_queue_, TcpWriteTask { std::move(chain), TaskStrategy::UNTIL_FINISHED }, std::move(callback), timeout);
+}
+
+Buffer TcpSocket::allocate_buffer(std::size_t size) {
+    auto runtime = runtime_.lock();
+    return Buffer::allocate(size, runtime ? runtime->pool() : nullptr);
+}
+
+bool TcpSocket::async_sendfile(int file_fd, off_t offset, std::size_t size, WriteCallback callback, Duration timeout) {
+    return submit(write_task_queue_, TcpWriteTask { WriteSource::FILE, file_fd, offset, size }, std::move(callback), timeout);
+}
+
+bool TcpSocket::async_splice(int pipe_fd, std::size_t size, WriteCallback callback, Duration timeout) {
+    return submit(write_task_queue_, TcpWriteTask { WriteSource::PIPE, pipe_fd, 0, size }, std::move(callback), timeout);
+}
+
+void TcpSocket::set_io_budget(std::size_t bytes) {
+    io_budget_.store(bytes > 0 ? bytes : 1, std::memory_order_relaxed);
+}
+
+void TcpSocket::set_zerocopy_threshold(std::size_t bytes) {
+    zerocopy_threshold_.store(bytes, std::memory_order_relaxed);
 }
 
-bool TcpSocket::async_read(uint8_t* buf, std::size_t size, const ReadCallback& callback) {
-    std::unique_lock<std::mutex> lck { read_mtx_ };
+void TcpSocket::set_idle_timeout(Duration timeout) {
+    idle_timeout_.store(std::max(timeout, Duration::zero()).count(), std::memory_order_relaxed);
+    run_in_runtime(&TcpSocket::arm_idle_timer);
+}
+
+TimerHandle TcpSocket::async_wait_for(TimerScheduler::Duration duration, const TimerScheduler::Callback& callback) {
+    return async_wait_until(TimerScheduler::Clock::now() + duration, callback);
+}
+
+TimerHandle TcpSocket::async_wait_until(TimerScheduler::TimePoint time_point, const TimerScheduler::Callback& callback) {
+    auto runtime = runtime_.lock();
+    if (!runtime) {
+        return {};
+    }
+    return runtime->timers()->schedule(time_point, callback);
+}
+
+void TcpSocket::set_inline_completion(bool enabled) {
+    inline_completion_.store(enabled, std::memory_order_relaxed);
+}
+
+void TcpSocket::cancel() {
+    run_in_runtime(&TcpSocket::discard_tasks);
+}
+
+bool TcpSocket::is_closed() {
+    return closed_;
+}
+
+bool TcpSocket::is_peer_closed() {
+    return peer_closed_;
+}
+
+void TcpSocket::close() {
+    close_with(EBADF);
+}
+
+Address TcpSocket::peer() {
+    return peer_;
+}
+
+TcpSocket::DeadlineTimer::DeadlineTimer(TcpSocket* socket, void (TcpSocket::*handler)())
+: armed_ { TimePoint::max() }
+, socket_ { socket }
+, handler_ { handler } {
+}
+
+void TcpSocket::DeadlineTimer::on_expired(TimePoint, TimePoint) {
+    armed_ = TimePoint::max();
+    (socket_->*handler_)();
+}
+
+void TcpSocket::close_with(int ec) {
+    bool expected = false;
+    if (!closed_.compare_exchange_strong(expected, true)) {
+        return;
+    }
+    if (connection_load_) {
+        connection_load_->connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // no task can be pushed after the producers which have passed the check of closed_ leave
+    while (producers_ != 0) {
+    }
+    // the runtime must be taken before it is detached by Handle::close
+    auto runtime = runtime_.lock();
+    if (zerocopy_next_id_.load(std::memory_order_acquire) != zerocopy_released_id_.load(std::memory_order_acquire)) {
+        // the kernel would keep sending from the pinned pages after the close, and report their release to nobody.
+        // a reset drops them right away, so the buffers of the pending zerocopy writes are free to go
+        ::linger abort { 1, 0 };
+        ::setsockopt(fd_, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    }
+    Handle::close();
+    if (runtime) {
+        cancel_timers(runtime->timers());
+    }
+    if (!runtime || runtime->in_runtime_thread()) {
+        release_tasks(ec);
+        return;
+    }
+    auto self = weak_from_this().lock();
+    if (!self) {
+        // the socket is being destroyed, so the runtime holds no reference to it
+        release_tasks(ec);
+        return;
+    }
+    runtime->post([self, ec]() { static_cast<TcpSocket*>(self.get())->release_tasks(ec); });
+}
+
+template <typename Queue, typename Task, typename Callback>
+bool TcpSocket::submit(Queue& queue, Task&& task, Callback&& callback, Duration timeout) {
+    if (timeout > Duration::zero()) {
+        task.set_deadline(TimerScheduler::Clock::now() + timeout);
+    }
+    producers_++;
     if (closed_) {
+        producers_--;
         return false;
     }
-    TcpReadTask task { buf, size, TaskStrategy::UNTIL_FINISHED };
-    read_task_queue_.push_back({ task, callback });
+    charge(task);
+    queue.push(std::move(task), std::move(callback));
+    producers_--;
+    // served after leaving the producers, since the callback may close the socket
+    auto action = std::is_same_v<Queue, ReadTaskQueue> ? &TcpSocket::do_read : &TcpSocket::do_write;
+    if (!serve_inline(queue, action)) {
+        schedule();
+    }
     return true;
 }
 
-bool TcpSocket::async_read_some(uint8_t* buf, std::size_t size, const ReadCallback& callback) {
-    std::unique_lock<std::mutex> lck { read_mtx_ };
-    if (closed_) {
+void TcpSocket::charge(TcpReadTask&) {
+}
+
+void TcpSocket::charge(TcpWriteTask& task) {
+    if (!load_) {
+        return;
+    }
+    std::size_t bytes = task.remaining_size();
+    task.set_charged(bytes);
+    load_->pending_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void TcpSocket::discharge(std::size_t bytes) {
+    if (bytes > 0) {
+        load_->pending_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+}
+
+void TcpSocket::schedule() {
+    if (auto runtime = runtime_.lock()) {
+        runtime->schedule(this);
+    }
+}
+
+template <typename Queue> bool TcpSocket::serve_inline(Queue& queue, void (TcpSocket::*action)()) {
+    if (!inline_completion_.load(std::memory_order_relaxed) || Runtime::current() == nullptr) {
+        return false;
+    }
+    auto runtime = runtime_.lock();
+    if (runtime.get() != Runtime::current()) {
+        return false;
+    }
+    // a task behind another one waits for it, and the direction being served picks the new task up by itself.
+    // the latter also bounds the recursion of the callbacks which start the next operation
+    bool serving = std::is_same_v<Queue, ReadTaskQueue> ? reading_ : writing_;
+    if (serving || queue.front() == nullptr || queue.at(1) != nullptr) {
         return false;
     }
-    TcpReadTask task { buf, size, TaskStrategy::TRY };
-    read_task_queue_.push_back({ task, callback });
+    (this->*action)();
     return true;
 }
 
-bool TcpSocket::async_write(uint8_t* buf, std::size_t size, const WriteCallback& callback) {
-    std::unique_lock<std::mutex> lck { write_mtx_ };
-    if (closed_) {
+void TcpSocket::run_in_runtime(void (TcpSocket::*action)()) {
+    // the task queues can only be consumed by the runtime thread
+    auto runtime = runtime_.lock();
+    if (!runtime || runtime->in_runtime_thread()) {
+        (this->*action)();
+        return;
+    }
+    auto self = weak_from_this().lock();
+    if (!self) {
+        (this->*action)();
+        return;
+    }
+    runtime->post([self, action]() { (static_cast<TcpSocket*>(self.get())->*action)(); });
+}
+
+void TcpSocket::release_tasks(int ec) {
+    queue_epoch_++;
+    unwatch_pipe();
+    while (read_task_queue_.front()) {
+        finish_read(Result::system_error(ec));
+    }
+    // the parked writes come before the queued ones
+    while (!zerocopy_completions_.empty()) {
+        auto completion = std::move(zerocopy_completions_.front());
+        zerocopy_completions_.pop_front();
+        // a write which has failed already keeps its own error
+        completion.callback(completion.result ? Result::system_error(ec) : completion.result, completion.size);
+    }
+    while (auto entry = write_task_queue_.front()) {
+        auto callback = std::move(entry->second);
+        auto size = entry->first.finished_size();
+        discharge(entry->first.charged());
+        write_task_queue_.pop();
+        callback(Result::system_error(ec), size);
+    }
+}
+
+void TcpSocket::discard_tasks() {
+    queue_epoch_++;
+    unwatch_pipe();
+    while (read_task_queue_.front()) {
+        read_task_queue_.pop();
+    }
+    while (auto entry = write_task_queue_.front()) {
+        if (entry->first.is_zerocopy()) {
+            // the callback is dropped, but the buffers wait for the kernel to release them
+            zerocopy_completions_.push_back({ entry->first.zerocopy_id(), 0, Result::ok(), [](Result, std::size_t) {},
+                entry->first.take_chain(), entry->first.take_buffer() });
+        }
+        discharge(entry->first.charged());
+        write_task_queue_.pop();
+    }
+    arm_deadline(read_task_queue_, read_deadline_timer_);
+    arm_deadline(write_task_queue_, write_deadline_timer_);
+}
+
+void TcpSocket::do_read() {
+    reading_ = true;
+    std::size_t transferred = read_tasks();
+    reading_ = false;
+    arm_deadline(read_task_queue_, read_deadline_timer_);
+    track_activity(transferred);
+}
+
+void TcpSocket::do_write() {
+    writing_ = true;
+    std::size_t transferred = write_tasks();
+    writing_ = false;
+    arm_deadline(write_task_queue_, write_deadline_timer_);
+    track_activity(transferred);
+}
+
+std::size_t TcpSocket::read_tasks() {
+    std::size_t budget = io_budget_.load(std::memory_order_relaxed);
+    std::size_t transferred = 0;
+    // keep serving the queued tasks until the socket is drained or the budget runs out
+    while (!closed_) {
+        auto entry = read_task_queue_.front();
+        if (entry == nullptr) {
+            return transferred;
+        }
+        if (transferred >= budget) {
+            // yield to the other sockets, the rest will be served on the next iteration
+            schedule();
+            return transferred;
+        }
+        auto& task = entry->first;
+        std::shared_ptr<Runtime> runtime {};
+        if (task.wants_buffer()) {
+            runtime = runtime_.lock();
+            task.provide(runtime ? runtime->provide_buffer() : Buffer::allocate(Runtime::PROVIDED_BUFFER_SIZE));
+        }
+        auto prev_size = task.finished_size();
+        auto ec = task.exec(fd_);
+        transferred = transferred + (task.finished_size() - prev_size);
+        if (runtime && task.finished_size() == 0) {
+            // nothing has arrived, so the buffer goes back before the task waits or fails
+            runtime->recycle_buffer(task.reclaim());
+        }
+        if (!task.finished() && !ec) {
+            // read again until EAGAIN, since the end of the stream may have arrived within the same edge
+            continue;
+        }
+        if (!task.finished() && ec.value() == EAGAIN) {
+            // wait for the next edge-triggered event
+            return transferred;
+        }
+        finish_read(task.finished() ? Result::ok() : Result::system_error(ec.value()));
+    }
+    return transferred;
+}
+
+std::size_t TcpSocket::write_tasks() {
+    std::size_t budget = io_budget_.load(std::memory_order_relaxed);
+    std::size_t transferred = 0;
+    // keep serving the queued tasks until the socket is full or the budget runs out
+    while (!closed_) {
+        auto entry = write_task_queue_.front();
+        if (entry == nullptr) {
+            return transferred;
+        }
+        if (entry->first.finished()) {
+            // an empty task is completed without a syscall
+            finish_write(Result::ok());
+            continue;
+        }
+        if (transferred >= budget) {
+            // yield to the other sockets, the rest will be served on the next iteration
+            schedule();
+            return transferred;
+        }
+        if (!entry->first.is_buffered()) {
+            // the kernel moves the bytes of a file or a pipe by itself, they are never gathered
+            auto& task = entry->first;
+            auto prev_size = task.finished_size();
+            auto ec = task.exec(fd_);
+            transferred = transferred + (task.finished_size() - prev_size);
+            if (!task.finished() && !ec) {
+                // a short transfer may have drained the source rather than filled the socket, so try again
+                continue;
+            }
+            if (!task.finished() && ec.value() == EAGAIN) {
+                // a writable socket means the pipe has run dry, which no edge of the socket would report
+                ::pollfd pfd { fd_, POLLOUT, 0 };
+                if (task.is_piped() && ::poll(&pfd, 1, 0) == 1) {
+                    watch_pipe(task.source_fd());
+                }
+                // otherwise wait for the next edge-triggered event
+                return transferred;
+            }
+            finish_write(task.finished() ? Result::ok() : Result::system_error(ec.value()));
+            continue;
+        }
+        // coalesce the consecutive buffered tasks into one gathered write,
+        // a large task is sent alone so that its pages can be pinned instead of copied
+        bool zerocopy = use_zerocopy(entry->first);
+        ::iovec iov[MAX_GATHERED_IOVECS];
+        std::size_t iov_count = 0;
+        std::size_t gathered_size = 0;
+        for (std::size_t i = 0; iov_count < MAX_GATHERED_IOVECS; i++) {
+            auto next = write_task_queue_.at(i);
+            if (next == nullptr || !next->first.is_buffered() || (i > 0 && (zerocopy || use_zerocopy(next->first)))) {
+                break;
+            }
+            std::size_t count = next->first.gather(iov + iov_count, MAX_GATHERED_IOVECS - iov_count);
+            for (std::size_t j = iov_count; j < iov_count + count; j++) {
+                gathered_size = gathered_size + iov[j].iov_len;
+            }
+            iov_count = iov_count + count;
+        }
+        ssize_t bytes {};
+        if (zerocopy) {
+            ::msghdr msg {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iov_count;
+            bytes = ::sendmsg(fd_, &msg, MSG_NOSIGNAL | MSG_ZEROCOPY);
+            if (bytes > 0) {
+                entry->first.set_zerocopy_id(zerocopy_next_id_.fetch_add(1, std::memory_order_release));
+            } else if (bytes == -1 && errno == ENOBUFS) {
+                // the pages cannot be pinned within the limit of the socket, so they are copied this time
+                bytes = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+            }
+        } else if (iov_count == 1) {
+            bytes = ::send(fd_, iov[0].iov_base, iov[0].iov_len, MSG_NOSIGNAL);
+        } else {
+            ::msghdr msg {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iov_count;
+            bytes = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+        }
+        if (bytes <= 0) {
+            int ec = bytes == 0 ? EBADF : errno;
+            if (ec == EAGAIN) {
+                // wait for the next edge-triggered event
+                return transferred;
+            }
+            finish_write(Result::system_error(ec));
+            continue;
+        }
+        transferred = transferred + bytes;
+        // hand the written bytes to the tasks in order, and complete the finished ones
+        std::size_t left = bytes;
+        uint64_t epoch = queue_epoch_;
+        while (left > 0 && !closed_ && epoch == queue_epoch_) {
+            auto& task = write_task_queue_.front()->first;
+            left = left - task.advance(left);
+            if (!task.finished()) {
+                break;
+            }
+            finish_write(Result::ok());
+        }
+        if (static_cast<std::size_t>(bytes) < gathered_size) {
+            // a short write means the socket buffer is full
+            return transferred;
+        }
+    }
+    return transferred;
+}
+
+bool TcpSocket::do_error() {
+    if (zerocopy_state_ != ZEROCOPY_ON && zerocopy_state_ != ZEROCOPY_OFF) {
         return false;
     }
-    TcpWriteTask task { buf, size, TaskStrategy::UNTIL_FINISHED };
-    write_task_queue_.push_back({ task, callback });
-    return true;
+    bool notified = false;
+    // a completion may close the socket, and its fd may be reused right away
+    while (!closed_) {
+        alignas(::cmsghdr) uint8_t control[CMSG_SPACE(sizeof(::sock_extended_err)) * 4];
+        ::msghdr msg {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(fd_, &msg, MSG_ERRQUEUE) == -1) {
+            return notified;
+        }
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            bool recverr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+            (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!recverr) {
+                continue;
+            }
+            auto err = reinterpret_cast<::sock_extended_err*>(CMSG_DATA(cmsg));
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            notified = true;
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                // the kernel has copied the bytes anyway (e.g. over loopback), so pinning them is only overhead
+                zerocopy_state_ = ZEROCOPY_OFF;
+            }
+            // the notification covers the sends from ee_info to ee_data
+            complete_zerocopy(err->ee_data);
+        }
+    }
+    return notified;
 }
 
-bool TcpSocket::async_write_some(uint8_t* buf, std::size_t size, const WriteCallback& callback) {
-    std::unique_lock<std::mutex> lck { write_mtx_ };
-    if (closed_) {
+void TcpSocket::do_hangup() {
+    peer_closed_ = true;
+}
+
+bool TcpSocket::use_zerocopy(TcpWriteTask& task) {
+    std::size_t threshold = zerocopy_threshold_.load(std::memory_order_relaxed);
+    if (threshold == 0 || task.remaining_size() < threshold) {
         return false;
     }
-    TcpWriteTask task { buf, size, TaskStrategy::TRY };
-    write_task_queue_.push_back({ task, callback });
-    return true;
+    if (zerocopy_state_ == ZEROCOPY_UNKNOWN) {
+        int on = 1;
+        bool ok = ::setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0;
+        zerocopy_state_ = ok ? ZEROCOPY_ON : ZEROCOPY_UNSUPPORTED;
+    }
+    return zerocopy_state_ == ZEROCOPY_ON;
 }
 
-void TcpSocket::cancel() {
-    std::scoped_lock lck { read_mtx_, write_mtx_ };
-    read_task_queue_.clear();
-    write_task_queue_.clear();
+void TcpSocket::finish_read(Result res) {
+    auto entry = read_task_queue_.front();
+    auto size = entry->first.finished_size();
+    Buffer buffer {};
+    std::shared_ptr<Runtime> runtime {};
+    if (entry->first.is_provided() && size > 0 && size <= Runtime::SMALL_READ_SIZE) {
+        runtime = runtime_.lock();
+    }
+    if (runtime && runtime->in_runtime_thread()) {
+        buffer = runtime->hand_over(entry->first.take_whole_buffer(), size);
+    } else {
+        buffer = entry->first.take_buffer();
+    }
+    auto completion = std::move(entry->second);
+    read_task_queue_.pop();
+    if (auto callback = std::get_if<ReadCallback>(&completion)) {
+        (*callback)(res, size);
+    } else {
+        std::get<BufferReadCallback>(completion)(res, std::move(buffer));
+    }
 }
 
-bool TcpSocket::is_closed() {
-    return closed_;
+void TcpSocket::finish_write(Result res) {
+    unwatch_pipe();
+    auto entry = write_task_queue_.front();
+    auto& task = entry->first;
+    auto size = task.finished_size();
+    bool pinned = task.is_zerocopy();
+    uint32_t id = pinned ? task.zerocopy_id() : zerocopy_next_id_.load(std::memory_order_relaxed) - 1;
+    auto completion = std::move(entry->second);
+    // the owned buffers of a pinned write outlive the task until the kernel releases them
+    auto chain = pinned ? task.take_chain() : BufferChain {};
+    auto buffer = pinned ? task.take_buffer() : Buffer {};
+    discharge(task.charged());
+    write_task_queue_.pop();
+    if (pinned || !zerocopy_completions_.empty()) {
+        // wait for the kernel to release the buffer even if the write has failed after a partial send,
+        // or for the earlier pinned writes to keep the order
+        zerocopy_completions_.push_back({ id, size, res, std::move(completion), std::move(chain), std::move(buffer) });
+        return;
+    }
+    completion(res, size);
 }
 
-void TcpSocket::close() {
-    bool expected = false;
-    if (!closed_.compare_exchange_weak(expected, true)) {
+void TcpSocket::watch_pipe(int pipe_fd) {
+    auto runtime = runtime_.lock();
+    if (!runtime) {
         return;
     }
-    Handle::close();
-    {
-        std::unique_lock<std::mutex> lck { read_mtx_ };
-        while (!read_task_queue_.empty()) {
-            auto [task, callback] = read_task_queue_.front();
-            read_task_queue_.pop_front();
-            lck.unlock();
-            callback(Result::system_error(EBADF), task.finished_size());
-            lck.lock();
-        }
+    unwatch_pipe();
+    pipe_watcher_ = runtime->make_pooled<PipeWatcher>(pipe_fd, weak_from_this());
+    runtime->register_handle(pipe_watcher_);
+}
+
+void TcpSocket::unwatch_pipe() {
+    if (pipe_watcher_) {
+        pipe_watcher_->close();
+        pipe_watcher_.reset();
+    }
+}
+
+void TcpSocket::complete_zerocopy(uint32_t id) {
+    // the ids wrap around, and the notifications arrive in order
+    zerocopy_released_id_.store(id + 1, std::memory_order_release);
+    while (!zerocopy_completions_.empty() && static_cast<int32_t>(zerocopy_completions_.front().id - id) <= 0) {
+        auto completion = std::move(zerocopy_completions_.front());
+        zerocopy_completions_.pop_front();
+        completion.callback(completion.result, completion.size);
+    }
+}
+
+template <typename Queue> void TcpSocket::arm_deadline(Queue& queue, DeadlineTimer& timer) {
+    // only the front task is timed, the tasks behind it wait for it anyway
+    auto entry = queue.front();
+    auto deadline = entry != nullptr && !closed_ ? entry->first.deadline() : TaskDeadline::max();
+    if (deadline == timer.armed_) {
+        return;
+    }
+    if (deadline == TaskDeadline::max()) {
+        disarm_timer(timer);
+    } else {
+        arm_timer(timer, deadline);
     }
-    {
-        std::unique_lock<std::mutex> lck { write_mtx_ };
-        while (!write_task_queue_.empty()) {
-            auto [task, callback] = write_task_queue_.front();
-            write_task_queue_.pop_front();
-            lck.unlock();
-            callback(Result::system_error(EBADF), task.finished_size());
-            lck.lock();
+}
+
+void TcpSocket::arm_timer(DeadlineTimer& timer, TimerScheduler::TimePoint time_point) {
+    auto timers = timers_.lock();
+    if (!timers) {
+        auto runtime = runtime_.lock();
+        if (!runtime) {
+            return;
         }
+        timers = runtime->timers();
+        timers_ = timers;
     }
+    timer.armed_ = time_point;
+    timers->schedule(&timer, time_point);
 }
 
-Address TcpSocket::peer() {
-    return peer_;
+void TcpSocket::disarm_timer(DeadlineTimer& timer) {
+    if (timer.armed_ == TimerScheduler::TimePoint::max()) {
+        return;
+    }
+    timer.armed_ = TimerScheduler::TimePoint::max();
+    if (auto timers = timers_.lock()) {
+        timers->cancel(&timer);
+    }
 }
 
-void TcpSocket::do_read() {
-    std::unique_lock<std::mutex> lck { read_mtx_ };
-    if (closed_) {
+void TcpSocket::arm_idle_timer() {
+    Duration timeout { idle_timeout_.load(std::memory_order_relaxed) };
+    if (closed_ || timeout == Duration::zero()) {
+        disarm_timer(idle_timer_);
         return;
     }
-    if (read_task_queue_.empty()) {
+    last_active_ = TimerScheduler::Clock::now();
+    arm_timer(idle_timer_, last_active_ + timeout);
+}
+
+void TcpSocket::track_activity(std::size_t transferred) {
+    if (idle_timeout_.load(std::memory_order_relaxed) == 0) {
         return;
     }
-    auto [task, callback] = read_task_queue_.front();
-    auto ec = task.exec(fd_);
-    if (task.finished()) {
-        read_task_queue_.pop_front();
-        lck.unlock();
-        callback(Result::ok(), task.finished_size());
-    } else if (ec && ec.value() != EAGAIN) {
-        read_task_queue_.pop_front();
-        lck.unlock();
-        callback(Result::system_error(ec.value()), task.finished_size());
+    if (idle_timer_.armed_ == TimerScheduler::TimePoint::max()) {
+        arm_idle_timer();
+    } else if (transferred > 0) {
+        // the idle timer is not moved here, it checks the last activity when it fires
+        last_active_ = TimerScheduler::Clock::now();
     }
 }
 
-void TcpSocket::do_write() {
-    std::unique_lock<std::mutex> lck { write_mtx_ };
-    if (closed_) {
-        return;
+void TcpSocket::cancel_timers(const std::shared_ptr<TimerScheduler>& timers) {
+    if (timers) {
+        timers->cancel(&read_deadline_timer_);
+        timers->cancel(&write_deadline_timer_);
+        timers->cancel(&idle_timer_);
+    }
+}
+
+void TcpSocket::on_read_deadline() {
+    auto now = TimerScheduler::Clock::now();
+    while (!closed_) {
+        auto entry = read_task_queue_.front();
+        if (entry == nullptr || entry->first.deadline() > now) {
+            break;
+        }
+        finish_read(Result::system_error(ETIMEDOUT));
     }
-    if (write_task_queue_.empty()) {
+    arm_deadline(read_task_queue_, read_deadline_timer_);
+}
+
+void TcpSocket::on_write_deadline() {
+    auto now = TimerScheduler::Clock::now();
+    while (!closed_) {
+        auto entry = write_task_queue_.front();
+        if (entry == nullptr || entry->first.deadline() > now) {
+            break;
+        }
+        // a write which has pinned some of its bytes completes once the kernel releases them
+        finish_write(Result::system_error(ETIMEDOUT));
+    }
+    arm_deadline(write_task_queue_, write_deadline_timer_);
+}
+
+void TcpSocket::on_idle_deadline() {
+    Duration timeout { idle_timeout_.load(std::memory_order_relaxed) };
+    if (closed_ || timeout == Duration::zero()) {
         return;
     }
-    auto [task, callback] = write_task_queue_.front();
-    auto ec = task.exec(fd_);
-    if (task.finished()) {
-        write_task_queue_.pop_front();
-        lck.unlock();
-        callback(Result::ok(), task.finished_size());
-    } else if (ec && ec.value() != EAGAIN) {
-        write_task_queue_.pop_front();
-        lck.unlock();
-        callback(Result::system_error(ec.value()), task.finished_size());
+    auto deadline = last_active_ + timeout;
+    if (deadline <= TimerScheduler::Clock::now()) {
+        close_with(ETIMEDOUT);
+        return;
     }
+    arm_timer(idle_timer_, deadline);
 }
\ No newline at end of file
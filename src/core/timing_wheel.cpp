@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <utility>
+
+#include "spinet/core/timing_wheel.h"
+
+namespace spinet {
+
+class CallbackTimer : public TimerNode {
+    public:
+    CallbackTimer(const TimerScheduler::Callback& callback, const std::shared_ptr<TimerScheduler>& scheduler)
+    : callback_ { callback }
+    , scheduler_ { scheduler } {
+    }
+
+    protected:
+    void on_expired(TimePoint time_point, TimePoint now) override {
+        // the scheduled timer keeps itself alive, and is released after the callback
+        auto self = std::move(self_);
+        callback_(time_point, now);
+    }
+
+    void on_dropped() override {
+        auto self = std::move(self_);
+    }
+
+    private:
+    friend class TimerScheduler;
+    friend class TimerHandle;
+
+    TimerScheduler::Callback callback_;
+    std::weak_ptr<TimerScheduler> scheduler_;
+    std::shared_ptr<CallbackTimer> self_;
+};
+
+}
+
+using namespace spinet;
+
+constexpr uint64_t SLOT_MASK = TimingWheel::SLOTS - 1;
+constexpr uint64_t WHEEL_SPAN_BITS = TimingWheel::SLOT_BITS * TimingWheel::LEVELS;
+
+TimerNode::TimerNode()
+: list_ { nullptr }
+, prev_ { nullptr }
+, next_ { nullptr }
+, expiry_ { 0 }
+, time_point_ {} {
+}
+
+TimerNode::~TimerNode() {
+}
+
+void TimerNode::on_dropped() {
+}
+
+TimingWheel::TimingWheel(TimePoint origin)
+: origin_ { origin }
+, current_ { 0 }
+, slots_ {}
+, occupied_ {}
+, overflow_ { nullptr }
+, expired_ { nullptr } {
+}
+
+TimingWheel::~TimingWheel() {
+    while (pop_any() != nullptr) {
+    }
+}
+
+void TimingWheel::schedule(TimerNode* node, TimePoint time_point) {
+    if (node->list_ != nullptr) {
+        unlink(node);
+    }
+    node->time_point_ = time_point;
+    // rounded up, so that a node never fires before its time point
+    node->expiry_ = std::max(to_tick(time_point, true), current_ + 1);
+    place(node);
+}
+
+void TimingWheel::cancel(TimerNode* node) {
+    if (node->list_ != nullptr) {
+        unlink(node);
+    }
+}
+
+bool TimingWheel::is_scheduled(TimerNode* node) {
+    return node->list_ != nullptr;
+}
+
+void TimingWheel::advance(TimePoint now) {
+    uint64_t target = to_tick(now, false);
+    while (current_ < target) {
+        // jump over the ticks which neither fire nor cascade any node
+        uint64_t next = next_tick();
+        if (next > target) {
+            current_ = target;
+            return;
+        }
+        current_ = next;
+        if ((current_ & ((uint64_t { 1 } << WHEEL_SPAN_BITS) - 1)) == 0) {
+            cascade(&overflow_);
+        }
+        // the higher levels go first, so a node can fall through several levels on the same tick
+        for (std::size_t level = LEVELS - 1; level > 0; level--) {
+            if ((current_ & ((uint64_t { 1 } << (SLOT_BITS * level)) - 1)) == 0) {
+                std::size_t index = (current_ >> (SLOT_BITS * level)) & SLOT_MASK;
+                occupied_[level] &= ~(uint64_t { 1 } << index);
+                cascade(&slots_[level][index]);
+            }
+        }
+        std::size_t index = current_ & SLOT_MASK;
+        occupied_[0] &= ~(uint64_t { 1 } << index);
+        TimerNode* list = slots_[0][index];
+        slots_[0][index] = nullptr;
+        while (list != nullptr) {
+            TimerNode* node = list;
+            list = node->next_;
+            link(&expired_, node);
+        }
+    }
+}
+
+TimerNode* TimingWheel::pop_expired() {
+    TimerNode* node = expired_;
+    if (node != nullptr) {
+        unlink(node);
+    }
+    return node;
+}
+
+TimerNode* TimingWheel::pop_any() {
+    TimerNode* node = expired_ != nullptr ? expired_ : overflow_;
+    for (std::size_t level = 0; node == nullptr && level < LEVELS; level++) {
+        if (occupied_[level] != 0) {
+            node = slots_[level][__builtin_ctzll(occupied_[level])];
+        }
+    }
+    if (node != nullptr) {
+        unlink(node);
+    }
+    return node;
+}
+
+std::optional<TimingWheel::TimePoint> TimingWheel::next_expiry() {
+    if (expired_ != nullptr) {
+        return origin_ + Tick { current_ };
+    }
+    uint64_t next = next_tick();
+    if (next == UINT64_MAX) {
+        return {};
+    }
+    return origin_ + Tick { next };
+}
+
+uint64_t TimingWheel::to_tick(TimePoint time_point, bool round_up) {
+    if (time_point <= origin_) {
+        return 0;
+    }
+    auto elapsed = time_point - origin_;
+    auto ticks = std::chrono::duration_cast<Tick>(elapsed);
+    if (round_up && ticks < elapsed) {
+        ticks = ticks + Tick { 1 };
+    }
+    return ticks.count();
+}
+
+uint64_t TimingWheel::next_tick() {
+    uint64_t next = UINT64_MAX;
+    for (std::size_t level = 0; level < LEVELS; level++) {
+        // the slots up to the current one on each level have been processed
+        std::size_t index = (current_ >> (SLOT_BITS * level)) & SLOT_MASK;
+        if (index == SLOT_MASK) {
+            continue;
+        }
+        uint64_t ahead = occupied_[level] & (~uint64_t { 0 } << (index + 1));
+        if (ahead == 0) {
+            continue;
+        }
+        std::size_t span_bits = SLOT_BITS * (level + 1);
+        uint64_t tick = ((current_ >> span_bits) << span_bits) |
+        (static_cast<uint64_t>(__builtin_ctzll(ahead)) << (SLOT_BITS * level));
+        next = std::min(next, tick);
+    }
+    if (overflow_ != nullptr) {
+        next = std::min(next, ((current_ >> WHEEL_SPAN_BITS) + 1) << WHEEL_SPAN_BITS);
+    }
+    return next;
+}
+
+void TimingWheel::place(TimerNode* node) {
+    // the lowest level whose slots cover both the current tick and the expiry in one revolution
+    for (std::size_t level = 0; level < LEVELS; level++) {
+        std::size_t span_bits = SLOT_BITS * (level + 1);
+        if ((node->expiry_ >> span_bits) == (current_ >> span_bits)) {
+            std::size_t index = (node->expiry_ >> (SLOT_BITS * level)) & SLOT_MASK;
+            occupied_[level] |= uint64_t { 1 } << index;
+            link(&slots_[level][index], node);
+            return;
+        }
+    }
+    link(&overflow_, node);
+}
+
+void TimingWheel::link(TimerNode** list, TimerNode* node) {
+    node->list_ = list;
+    node->prev_ = nullptr;
+    node->next_ = *list;
+    if (*list != nullptr) {
+        (*list)->prev_ = node;
+    }
+    *list = node;
+}
+
+void TimingWheel::unlink(TimerNode* node) {
+    TimerNode** list = node->list_;
+    if (node->prev_ != nullptr) {
+        node->prev_->next_ = node->next_;
+    } else {
+        *list = node->next_;
+    }
+    if (node->next_ != nullptr) {
+        node->next_->prev_ = node->prev_;
+    }
+    node->list_ = nullptr;
+    node->prev_ = nullptr;
+    node->next_ = nullptr;
+    if (*list == nullptr && list >= &slots_[0][0] && list < &slots_[0][0] + LEVELS * SLOTS) {
+        std::size_t position = list - &slots_[0][0];
+        occupied_[position / SLOTS] &= ~(uint64_t { 1 } << (position % SLOTS));
+    }
+}
+
+void TimingWheel::cascade(TimerNode** list) {
+    TimerNode* node = *list;
+    *list = nullptr;
+    while (node != nullptr) {
+        TimerNode* next = node->next_;
+        place(node);
+        node = next;
+    }
+}
+
+TimerHandle::TimerHandle() {
+}
+
+TimerHandle::~TimerHandle() {
+}
+
+void TimerHandle::cancel() {
+    auto timer = timer_.lock();
+    if (!timer) {
+        return;
+    }
+    if (auto scheduler = timer->scheduler_.lock()) {
+        scheduler->cancel(timer.get());
+    }
+}
+
+bool TimerHandle::is_pending() {
+    auto timer = timer_.lock();
+    if (!timer) {
+        return false;
+    }
+    auto scheduler = timer->scheduler_.lock();
+    if (!scheduler) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lck { scheduler->mtx_ };
+    return scheduler->wheel_.is_scheduled(timer.get());
+}
+
+TimerHandle::TimerHandle(const std::shared_ptr<CallbackTimer>& timer)
+: timer_ { timer } {
+}
+
+TimerScheduler::TimerScheduler(std::function<void()> on_earlier)
+: wheel_ { Clock::now() }
+, on_earlier_ { std::move(on_earlier) }
+, firing_ { nullptr }
+, firing_thread_id_ {}
+, fired_cv_ {} {
+}
+
+TimerScheduler::~TimerScheduler() {
+    clear();
+}
+
+TimerHandle TimerScheduler::schedule(TimePoint time_point, const Callback& callback) {
+    auto timer = std::make_shared<CallbackTimer>(callback, shared_from_this());
+    timer->self_ = timer;
+    schedule(timer.get(), time_point);
+    return TimerHandle { timer };
+}
+
+void TimerScheduler::schedule(TimerNode* node, TimePoint time_point) {
+    bool earlier = false;
+    {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        auto prev = wheel_.next_expiry();
+        wheel_.schedule(node, time_point);
+        auto next = wheel_.next_expiry();
+        earlier = !prev || next < prev;
+    }
+    if (earlier && on_earlier_) {
+        on_earlier_();
+    }
+}
+
+void TimerScheduler::cancel(TimerNode* node) {
+    {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        // the owner may be destroyed once this returns, so an expiry on another thread must finish first. the
+        // expiring thread itself goes on, the node may be cancelling itself
+        if (firing_ == node && firing_thread_id_ != std::this_thread::get_id()) {
+            fired_cv_.wait(lck, [this, node]() { return firing_ != node; });
+        }
+        if (!wheel_.is_scheduled(node)) {
+            return;
+        }
+        wheel_.cancel(node);
+    }
+    node->on_dropped();
+}
+
+std::optional<TimerScheduler::TimePoint> TimerScheduler::next_expiry() {
+    std::unique_lock<std::mutex> lck { mtx_ };
+    return wheel_.next_expiry();
+}
+
+void TimerScheduler::expire(TimePoint now) {
+    {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        wheel_.advance(now);
+    }
+    // pop one by one, so a callback may still cancel the other expired nodes
+    while (true) {
+        TimerNode* node = nullptr;
+        {
+            std::unique_lock<std::mutex> lck { mtx_ };
+            node = wheel_.pop_expired();
+            firing_ = node;
+            firing_thread_id_ = std::this_thread::get_id();
+        }
+        if (node == nullptr) {
+            return;
+        }
+        node->on_expired(node->time_point_, now);
+        {
+            // the node may have been destroyed by on_expired, only the pointer is compared
+            std::unique_lock<std::mutex> lck { mtx_ };
+            firing_ = nullptr;
+        }
+        fired_cv_.notify_all();
+    }
+}
+
+void TimerScheduler::clear() {
+    while (true) {
+        TimerNode* node = nullptr;
+        {
+            std::unique_lock<std::mutex> lck { mtx_ };
+            node = wheel_.pop_any();
+        }
+        if (node == nullptr) {
+            return;
+        }
+        node->on_dropped();
+    }
+}
\ No newline at end of file
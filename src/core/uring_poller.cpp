@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <cstring>
+
+#include "errno.h"
+#include "sys/epoll.h"
+#include "sys/eventfd.h"
+#include "sys/mman.h"
+#include "sys/socket.h"
+#include "sys/syscall.h"
+#include "unistd.h"
+
+#include "uring_poller.h"
+
+using namespace spinet;
+
+constexpr unsigned URING_ENTRIES = 256;
+constexpr uint64_t IGNORED_TOKEN = 0; // the completions of the remove requests
+constexpr uint64_t ACCEPT_TOKEN = uint64_t { 1 } << 63; // set in the tokens of the accept requests
+
+UringPoller::UringPoller()
+: ring_fd_ { -1 }
+, sq_ring_ { MAP_FAILED }
+, sq_ring_size_ { 0 }
+, cq_ring_ { MAP_FAILED }
+, cq_ring_size_ { 0 }
+, sqes_ { static_cast<::io_uring_sqe*>(MAP_FAILED) }
+, sqes_size_ { 0 }
+, features_ { 0 }
+, waiting_thread_id_ {}
+, next_token_ { IGNORED_TOKEN + 1 } {
+    if (!setup() || !probe_multishot_poll()) {
+        release();
+    }
+}
+
+UringPoller::~UringPoller() {
+    release();
+}
+
+bool UringPoller::is_available() {
+    return ring_fd_ != -1;
+}
+
+Backend UringPoller::backend() {
+    return Backend::URING_POLL;
+}
+
+bool UringPoller::add(int fd, void* data, uint32_t events) {
+    {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        if (tokens_.find(fd) != tokens_.end()) {
+            return false;
+        }
+        uint64_t token = next_token(false);
+        Registration registration { fd, data, events, false };
+        registrations_.insert({ token, registration });
+        tokens_.insert({ fd, token });
+        prepare_poll_add(token, registration);
+    }
+    submit_if_foreign();
+    return true;
+}
+
+bool UringPoller::add_listener(int fd, void* data) {
+    {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        if (tokens_.find(fd) != tokens_.end()) {
+            return false;
+        }
+        uint64_t token = next_token(true);
+        Registration registration { fd, data, EPOLLIN | EPOLLRDHUP, true };
+        registrations_.insert({ token, registration });
+        tokens_.insert({ fd, token });
+        prepare_accept(token, registration);
+    }
+    submit_if_foreign();
+    return true;
+}
+
+bool UringPoller::modify(int fd, void* data, uint32_t events) {
+    {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        auto find = tokens_.find(fd);
+        if (find == tokens_.end()) {
+            return false;
+        }
+        // the request is replaced by a poll, so the pending completions of the old one are dropped
+        auto prev = registrations_.find(find->second);
+        prepare_remove(prev->first, prev->second);
+        registrations_.erase(prev);
+        uint64_t token = next_token(false);
+        Registration registration { fd, data, events, false };
+        registrations_.insert({ token, registration });
+        find.value() = token;
+        prepare_poll_add(token, registration);
+    }
+    submit_if_foreign();
+    return true;
+}
+
+void UringPoller::remove(int fd) {
+    {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        auto find = tokens_.find(fd);
+        if (find == tokens_.end()) {
+            return;
+        }
+        auto registration = registrations_.find(find->second);
+        prepare_remove(registration->first, registration->second);
+        registrations_.erase(registration);
+        tokens_.erase(find);
+    }
+    submit_if_foreign();
+}
+
+int UringPoller::wait(Event* events, int capacity, int timeout) {
+    unsigned to_submit {};
+    {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        waiting_thread_id_ = std::this_thread::get_id();
+        to_submit = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    }
+    // the pending registrations are submitted by the same syscall which waits for the completions
+    bool has_completions = *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (!has_completions && timeout != 0) {
+        enter(to_submit, 1, IORING_ENTER_GETEVENTS, timeout);
+    } else if (to_submit > 0) {
+        enter(to_submit, 0, 0, 0);
+    }
+    std::unique_lock<std::mutex> lck { mtx_ };
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    int event_size = 0;
+    while (head != tail && event_size < capacity) {
+        ::io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+        head++;
+        auto find = registrations_.find(cqe->user_data);
+        if (cqe->user_data == IGNORED_TOKEN || find == registrations_.end()) {
+            if ((cqe->user_data & ACCEPT_TOKEN) && cqe->res >= 0) {
+                // accepted before the cancellation of a removed listener took effect
+                ::close(cqe->res);
+            }
+            continue;
+        }
+        const Registration& registration = find->second;
+        if (registration.accepting) {
+            if (cqe->res >= 0) {
+                events[event_size++] = { registration.data, 0, cqe->res };
+            }
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                if (cqe->res < 0 && cqe->res != -ECANCELED) {
+                    // unsupported by the kernel, or an error such as EMFILE which the handle copes with
+                    fall_back_to_poll(find->first);
+                } else {
+                    prepare_accept(find->first, registration);
+                }
+            }
+            continue;
+        }
+        if (cqe->res < 0) {
+            if (cqe->res != -ECANCELED) {
+                events[event_size++] = { registration.data, EPOLLERR, -1 };
+            }
+            continue;
+        }
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            // the kernel has terminated the multishot request, so it is armed again
+            prepare_poll_add(find->first, registration);
+        }
+        events[event_size++] = { registration.data, static_cast<uint32_t>(cqe->res), -1 };
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return event_size;
+}
+
+bool UringPoller::setup() {
+    ::io_uring_params params {};
+    ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, URING_ENTRIES, &params));
+    if (ring_fd_ < 0) {
+        ring_fd_ = -1;
+        return false;
+    }
+    features_ = params.features;
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        cq_ring_size_ = sq_ring_size_;
+    }
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        return false;
+    }
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(::io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    sqes_ = static_cast<::io_uring_sqe*>(sqes);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    uint8_t* sq = static_cast<uint8_t*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    uint8_t* cq = static_cast<uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<::io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+bool UringPoller::probe_multishot_poll() {
+    // multishot poll requires linux 5.13, the older kernels complete the request once or reject it
+    int probe_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (probe_fd == -1) {
+        return false;
+    }
+    add(probe_fd, nullptr, EPOLLIN);
+    uint64_t value { 1 };
+    [[maybe_unused]] auto res = ::write(probe_fd, &value, sizeof(value));
+    enter(0, 1, IORING_ENTER_GETEVENTS, -1);
+    bool supported = false;
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        ::io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+        head++;
+        if (cqe->user_data != IGNORED_TOKEN && cqe->res > 0 && (cqe->flags & IORING_CQE_F_MORE)) {
+            supported = true;
+        }
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    remove(probe_fd);
+    ::close(probe_fd);
+    return supported;
+}
+
+void UringPoller::release() {
+    if (sqes_ != MAP_FAILED) {
+        ::munmap(sqes_, sqes_size_);
+        sqes_ = static_cast<::io_uring_sqe*>(MAP_FAILED);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+        ::munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = MAP_FAILED;
+    if (sq_ring_ != MAP_FAILED) {
+        ::munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = MAP_FAILED;
+    }
+    if (ring_fd_ != -1) {
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+    }
+}
+
+::io_uring_sqe* UringPoller::next_sqe() {
+    unsigned tail = *sq_tail_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        // the submission queue is full, so flush it first
+        enter(sq_entries_, 0, 0, 0);
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            return nullptr;
+        }
+    }
+    unsigned index = tail & sq_mask_;
+    ::io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(::io_uring_sqe));
+    sq_array_[index] = index;
+    return sqe;
+}
+
+uint64_t UringPoller::next_token(bool accepting) {
+    uint64_t token = next_token_++;
+    return accepting ? token | ACCEPT_TOKEN : token;
+}
+
+void UringPoller::prepare_poll_add(uint64_t token, const Registration& registration) {
+    ::io_uring_sqe* sqe = next_sqe();
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = registration.fd;
+    sqe->poll32_events = registration.events & ~EPOLLET; // the poll requests are always edge-triggered
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = token;
+    __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+}
+
+void UringPoller::prepare_accept(uint64_t token, const Registration& registration) {
+    ::io_uring_sqe* sqe = next_sqe();
+    if (sqe == nullptr) {
+        return;
+    }
+    // the peer address is not collected, a socket asks for it only when it is needed
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = registration.fd;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = token;
+    __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+}
+
+void UringPoller::prepare_remove(uint64_t token, const Registration& registration) {
+    ::io_uring_sqe* sqe = next_sqe();
+    if (sqe == nullptr) {
+        return;
+    }
+    // an accept request holds the listener open until it is cancelled, closing the fd does not end it
+    sqe->opcode = registration.accepting ? IORING_OP_ASYNC_CANCEL : IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = token;
+    sqe->user_data = IGNORED_TOKEN;
+    __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+}
+
+void UringPoller::fall_back_to_poll(uint64_t token) {
+    auto find = registrations_.find(token);
+    Registration registration = find->second;
+    registrations_.erase(find);
+    registration.accepting = false;
+    uint64_t poll_token = next_token(false);
+    registrations_.insert({ poll_token, registration });
+    tokens_[registration.fd] = poll_token;
+    prepare_poll_add(poll_token, registration);
+}
+
+int UringPoller::enter(unsigned to_submit, unsigned min_complete, unsigned flags, int timeout) {
+    if (timeout > 0 && (flags & IORING_ENTER_GETEVENTS)) {
+        if (!(features_ & IORING_FEAT_EXT_ARG)) {
+            // a bounded wait is not supported by this kernel
+            return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, to_submit, 0, 0, nullptr, 0));
+        }
+        ::__kernel_timespec ts { timeout / 1000, (timeout % 1000) * 1000000 };
+        ::io_uring_getevents_arg arg {};
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        return static_cast<int>(::syscall(
+        __NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)));
+    }
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags, nullptr, 0));
+}
+
+void UringPoller::submit_if_foreign() {
+    unsigned to_submit {};
+    {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        if (waiting_thread_id_ == std::this_thread::get_id()) {
+            // submitted by the next wait
+            return;
+        }
+        to_submit = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    }
+    if (to_submit > 0) {
+        enter(to_submit, 0, 0, 0);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "linux/io_uring.h"
+
+#include "tsl/robin_map.h"
+
+#include "poller.h"
+
+namespace spinet {
+
+// A poller built on the multishot requests of io_uring. The sockets are polled for their readiness, while a listener
+// is served by a multishot accept, so its connections arrive with the completions and take no syscall of their own.
+// The registrations made on the waiting thread are submitted together with the next wait, and the completions are
+// reaped from the shared ring in batches.
+class UringPoller : public Poller {
+    public:
+    UringPoller();
+    ~UringPoller();
+
+    bool is_available();
+
+    Backend backend() override;
+    bool add(int fd, void* data, uint32_t events) override;
+    bool add_listener(int fd, void* data) override;
+    bool modify(int fd, void* data, uint32_t events) override;
+    void remove(int fd) override;
+    int wait(Event* events, int capacity, int timeout) override;
+
+    private:
+    template <typename K, typename V> using Map = tsl::robin_map<K, V>;
+
+    struct Registration {
+        int fd;
+        void* data;
+        uint32_t events;
+        bool accepting; // served by a multishot accept rather than a multishot poll
+    };
+
+    UringPoller(UringPoller&& other) = delete;
+    UringPoller& operator=(UringPoller&& other) = delete;
+    UringPoller(const UringPoller& other) = delete;
+    UringPoller& operator=(const UringPoller& other) = delete;
+
+    bool setup();
+    bool probe_multishot_poll();
+    void release();
+    ::io_uring_sqe* next_sqe();
+    uint64_t next_token(bool accepting);
+    void prepare_poll_add(uint64_t token, const Registration& registration);
+    void prepare_accept(uint64_t token, const Registration& registration);
+    void prepare_remove(uint64_t token, const Registration& registration);
+    // turn a listener whose multishot accept has ended for good into a polled one, which is accepted by its handle
+    void fall_back_to_poll(uint64_t token);
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags, int timeout);
+    void submit_if_foreign();
+
+    int ring_fd_;
+    void* sq_ring_;
+    std::size_t sq_ring_size_;
+    void* cq_ring_;
+    std::size_t cq_ring_size_;
+    ::io_uring_sqe* sqes_;
+    std::size_t sqes_size_;
+    uint32_t features_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    ::io_uring_cqe* cqes_;
+
+    // guards the submission queue and the registrations, the completion queue is only touched by the waiting thread
+    std::mutex mtx_;
+    std::thread::id waiting_thread_id_;
+    uint64_t next_token_;
+    // every poll request is tagged with a token, so the completions of a removed fd are recognized and dropped
+    Map<uint64_t, Registration> registrations_;
+    Map<int, uint64_t> tokens_;
+};
+
+}
\ No newline at end of file
@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <cstring>
 #include <utility>
 
 #include "errno.h"
+#include "linux/filter.h"
 #include "unistd.h"
 
 #include "core/runtime.h"
@@ -16,7 +18,8 @@ class TcpAcceptor : public BaseAcceptor {
     TcpAcceptor(int fd, const Address& address, Server::Settings* settings, std::function<void(std::shared_ptr<TcpSocket>)> accept_callback)
     : bind_address_ { address }
     , settings_ { settings }
-    , accept_callback_ { std::move(accept_callback) } {
+    , accept_callback_ { std::move(accept_callback) }
+    , accepted_ {} {
         fd_ = fd;
     }
     ~TcpAcceptor() {
@@ -24,46 +27,154 @@ class TcpAcceptor : public BaseAcceptor {
 
     protected:
     void do_accept() override {
-        ::sockaddr_in socket_address {};
-        ::socklen_t address_size = sizeof(socket_address);
         auto runtime = runtime_.lock();
         if (!runtime) {
             return;
         }
-        while (true) {
-            int socket_fd = ::accept(fd_, (::sockaddr*)&socket_address, &address_size);
+        // the listener is level-triggered, so the connections left by the budget are reported again on the next
+        // iteration, after the other handles of this worker have been served
+        for (std::size_t i = 0; i < settings_->accept_budget; i++) {
+            ::sockaddr_storage socket_address {};
+            ::socklen_t address_size = sizeof(socket_address);
+            int socket_fd = ::accept4(
+            fd_, reinterpret_cast<::sockaddr*>(&socket_address), &address_size, SOCK_NONBLOCK | SOCK_CLOEXEC);
             if (socket_fd == -1) {
-                return;
+                break;
+            }
+            auto peer = Address::from_sockaddr(reinterpret_cast<::sockaddr*>(&socket_address), address_size);
+            if (peer.index() == 1) {
+                ::close(socket_fd);
+                continue;
             }
-            set_nonblock(socket_fd);
-            if (settings_->reuse_port) {
-                set_reuse_port(socket_fd);
+            if (auto socket = make_socket(*runtime, socket_fd, std::get<0>(peer))) {
+                accepted_.push_back(std::move(socket));
             }
-            std::shared_ptr<TcpSocket> socket { new TcpSocket(
-            socket_fd, std::get<0>(Address::parse(from_sockaddr_in(socket_address), ntohs(socket_address.sin_port)))) };
-            runtime->register_handle(socket);
+        }
+        runtime->register_handles(accepted_);
+        for (auto& socket : accepted_) {
             accept_callback_(socket);
         }
+        accepted_.clear(); // the capacity is kept for the next event
+    }
+
+    void do_accepted(int socket_fd) override {
+        auto runtime = runtime_.lock();
+        if (!runtime) {
+            ::close(socket_fd);
+            return;
+        }
+        // the poller accepts without the peer address, so it is asked for here
+        ::sockaddr_storage socket_address {};
+        ::socklen_t address_size = sizeof(socket_address);
+        if (::getpeername(socket_fd, reinterpret_cast<::sockaddr*>(&socket_address), &address_size) == -1) {
+            ::close(socket_fd);
+            return;
+        }
+        auto peer = Address::from_sockaddr(reinterpret_cast<::sockaddr*>(&socket_address), address_size);
+        if (peer.index() == 1) {
+            ::close(socket_fd);
+            return;
+        }
+        auto socket = make_socket(*runtime, socket_fd, std::get<0>(peer));
+        if (!socket) {
+            return;
+        }
+        runtime->register_handle(socket);
+        accept_callback_(socket);
+    }
+
+    // null if the worker holds max_connections already, the connection is refused then rather than left in the
+    // backlog, which would keep the listener readable
+    std::shared_ptr<TcpSocket> make_socket(Runtime& runtime, int socket_fd, const Address& peer) {
+        auto& load = runtime.load();
+        if (settings_->max_connections > 0 && load->connections.load(std::memory_order_relaxed) >= settings_->max_connections) {
+            ::close(socket_fd);
+            return {};
+        }
+        auto socket = runtime.make_pooled<TcpSocket>(socket_fd, peer);
+        socket->set_io_budget(settings_->io_budget);
+        socket->set_zerocopy_threshold(settings_->zerocopy_threshold);
+        socket->set_inline_completion(settings_->inline_completion);
+        // the count covers the accepted sockets only, not the listeners, timers or pipes of the worker
+        load->connections.fetch_add(1, std::memory_order_relaxed);
+        socket->connection_load_ = load;
+        return socket;
     }
 
     Address bind_address_;
     Server::Settings* settings_;
     std::function<void(std::shared_ptr<TcpSocket>)> accept_callback_;
+    std::vector<std::shared_ptr<TcpSocket>> accepted_; // only touched by the runtime thread
 };
 
 }
 
 using namespace spinet;
 
+// a reuseport program which picks the listener of the worker pinned to the cpu handling the packet, the listeners
+// are indexed in the order they started listening. any other cpu falls back to a fixed spread over the workers
+static bool attach_cpu_steering(int fd, const std::vector<int>& cpus) {
+    std::vector<::sock_filter> code {};
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+    for (std::size_t i = 0; i < cpus.size(); i++) {
+        code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(cpus[i]), 0, 1));
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(i)));
+    }
+    code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<uint32_t>(cpus.size())));
+    code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+    ::sock_fprog program { static_cast<unsigned short>(code.size()), code.data() };
+    return ::setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == 0;
+}
+
 std::optional<std::string> Server::Settings::validate() {
     if (workers < 1) {
         return "workers must be more than zero";
     }
+    if (io_budget < 1) {
+        return "io_budget must be more than zero";
+    }
+    if (accept_budget < 1) {
+        return "accept_budget must be more than zero";
+    }
+    for (auto& cpus : worker_cpus) {
+        if (cpus.empty()) {
+            return "worker_cpus must not contain an empty set";
+        }
+        for (int cpu : cpus) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE) {
+                return "worker_cpus contains an invalid cpu";
+            }
+        }
+    }
+    if (cpu_steering && worker_cpus.empty() && workers > allowed_cpus().size()) {
+        return "workers must not be more than the cpus for cpu_steering";
+    }
+    if (cpu_steering && !worker_cpus.empty()) {
+        std::vector<int> firsts {};
+        for (std::size_t i = 0; i < workers; i++) {
+            int cpu = worker_cpus[i % worker_cpus.size()][0];
+            if (std::find(firsts.begin(), firsts.end(), cpu) != firsts.end()) {
+                return "the workers must start with distinct cpus for cpu_steering";
+            }
+            firsts.push_back(cpu);
+        }
+    }
     return {};
 }
 
 Server::Settings Server::Settings::default_settings() {
-    return { .workers = 1, .reuse_port = false };
+    return { .workers = 1,
+        .reuse_port = false,
+        .io_budget = 256 * 1024,
+        .backend = Backend::EPOLL,
+        .zerocopy_threshold = 0,
+        .inline_completion = false,
+        .max_connections = 0,
+        .accept_budget = 64,
+        .cpu_steering = false,
+        .worker_cpus = {},
+        .numa_binding = false,
+        .thread_name = "spinet" };
 }
 
 Server::Server()
@@ -89,12 +200,40 @@ std::optional<std::string> Server::with_settings(Settings settings) {
         return err;
     }
     settings_ = settings;
+    if (settings_->cpu_steering && settings_->worker_cpus.empty()) {
+        // one allowed cpu for each worker
+        for (int cpu : allowed_cpus()) {
+            settings_->worker_cpus.push_back({ cpu });
+        }
+        settings_->worker_cpus.resize(settings_->workers);
+    }
     for (std::size_t i = 0; i < settings_->workers; i++) {
-        workers_.push_back(std::shared_ptr<Runtime> { new Runtime() });
+        workers_.push_back(std::shared_ptr<Runtime> { new Runtime(settings_->backend) });
+        place_worker(*workers_.back(), i);
+        if (settings_->cpu_steering) {
+            auto& sets = settings_->worker_cpus;
+            worker_cpus_.push_back(sets[i % sets.size()][0]);
+        }
     }
     return {};
 }
 
+void Server::place_worker(Runtime& worker, std::size_t index) {
+    worker.set_thread_name(settings_->thread_name + std::to_string(index));
+    auto& sets = settings_->worker_cpus;
+    if (sets.empty()) {
+        return;
+    }
+    auto& cpus = sets[index % sets.size()];
+    worker.set_cpu_affinity(cpus);
+    if (settings_->numa_binding) {
+        int node = numa_node_of_cpu(cpus[0]);
+        if (node >= 0) {
+            worker.bind_numa_node(node);
+        }
+    }
+}
+
 bool Server::has_settings() {
     std::unique_lock<std::mutex> lck { mtx_ };
     return settings_.has_value();
@@ -109,14 +248,9 @@ Server::listen_tcp_endpoint(Address& address, const std::function<void(std::shar
     if (!settings_) {
         return "settings has been not set";
     }
-    auto res = to_sockaddr_in(address.address().c_str(), address.port());
-    if (res.index() == 1) {
-        return std::get<1>(res);
-    }
-    ::sockaddr_in socket_address = std::get<0>(res);
     std::vector<int> listen_fds {};
     for (std::size_t i = 0; i < workers_.size(); i++) {
-        int listen_fd = ::socket(socket_address.sin_family, SOCK_STREAM, 0);
+        int listen_fd = ::socket(address.sockaddr()->sa_family, SOCK_STREAM, 0);
         if (listen_fd == -1) {
             std::string err = std::string { "socket cannot open, reason:" } + std::strerror(errno);
             for (std::size_t i = 0; i < listen_fds.size(); i++) {
@@ -125,10 +259,15 @@ Server::listen_tcp_endpoint(Address& address, const std::function<void(std::shar
             return err;
         }
         set_reuse_port(listen_fd);
+        if (settings_->cpu_steering) {
+            // the kernel also prefers the listener of the receiving cpu without the program
+            int cpu = worker_cpus_[i];
+            ::setsockopt(listen_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+        }
         listen_fds.push_back(listen_fd);
-        if (::bind(listen_fd, reinterpret_cast<::sockaddr*>(&socket_address), sizeof(socket_address)) != 0) {
-            std::string err = std::string { "socket cannot bind with address " } + from_sockaddr_in(socket_address) +
-            ":" + std::to_string(ntohs(socket_address.sin_port)) + ", reason:" + std::strerror(errno);
+        if (::bind(listen_fd, address.sockaddr(), address.sockaddr_length()) != 0) {
+            std::string err = std::string { "socket cannot bind with address " } + address.to_string() +
+            ", reason:" + std::strerror(errno);
             for (std::size_t i = 0; i < listen_fds.size(); i++) {
                 ::close(listen_fds[i]);
             }
@@ -143,6 +282,13 @@ Server::listen_tcp_endpoint(Address& address, const std::function<void(std::shar
         }
         set_nonblock(listen_fd);
     }
+    if (settings_->cpu_steering && !attach_cpu_steering(listen_fds[0], worker_cpus_)) {
+        std::string err = std::string { "socket cannot steer by cpu, reason:" } + std::strerror(errno);
+        for (std::size_t i = 0; i < listen_fds.size(); i++) {
+            ::close(listen_fds[i]);
+        }
+        return err;
+    }
     for (std::size_t i = 0; i < listen_fds.size(); i++) {
         std::shared_ptr<TcpAcceptor> acceptor { new TcpAcceptor(listen_fds[i], address, &settings_.value(), accept_callback) };
         workers_[i]->register_handle(acceptor);
@@ -172,10 +318,13 @@ void Server::stop() {
     if (!running_) {
         return;
     }
+    running_ = false;
+    // the workers are joined without the lock, since the callbacks cancelled by a stopping worker may call back
+    // into this server
+    lck.unlock();
     for (auto& worker : workers_) {
         worker->stop();
     }
-    running_ = false;
 }
 
 bool Server::is_running() {
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <utility>
 
 #include "spinet/timer.h"
@@ -8,16 +9,18 @@ constexpr Timer::Duration MINIMUM_PRECISION = Timer::Duration { 1 };
 
 Timer::Timer(Duration precision)
 : running_ { false }
-, stopped_ { true } {
+, stopped_ { true }
+, scheduler_ { std::make_shared<TimerScheduler>([this]() { notify(); }) } {
     if (precision < MINIMUM_PRECISION) {
         precision_ = MINIMUM_PRECISION;
     } else {
-        precision_ = std::chrono::duration_cast<Duration>(precision - (precision_ % MINIMUM_PRECISION));
+        precision_ = std::chrono::duration_cast<Duration>(precision - (precision % MINIMUM_PRECISION));
     }
 }
 
 Timer::~Timer() {
     stop();
+    scheduler_->clear();
 }
 
 void Timer::run() {
@@ -29,15 +32,14 @@ void Timer::run() {
     if (timer_thread_.joinable()) {
         timer_thread_.join();
     }
+    stopped_ = false;
     timer_thread_ = std::thread { &Timer::exec, this };
 }
 
 void Timer::stop() {
     if (running_) {
         stopped_ = true;
-        while (running_) {
-            waiter_cv_.notify_all();
-        }
+        notify();
         std::unique_lock<std::mutex> lck { thread_mtx_ };
         if (timer_thread_.joinable()) {
             timer_thread_.join();
@@ -50,58 +52,34 @@ bool Timer::is_running() {
 }
 
 void Timer::exec() {
-    stopped_ = false;
     while (!stopped_) {
-        TimePoint time_point {};
-        {
-            std::unique_lock<std::mutex> lck { waiter_mtx_ };
-            time_point = std::chrono::steady_clock::now();
-            std::vector<WaitOperation> operations {};
-            while (!waiters_.empty()) {
-                auto& operation = waiters_.top();
-                if (operation.time_point > time_point) {
-                    break;
-                }
-                operations.push_back(operation);
-                waiters_.pop();
-            }
-            lck.unlock();
-            for (auto& [prev_time_point, callback] : operations) {
-                callback(prev_time_point, time_point);
-            }
+        TimePoint time_point = std::chrono::steady_clock::now();
+        scheduler_->expire(time_point);
+        std::unique_lock<std::mutex> lck { waiter_mtx_ };
+        if (stopped_) {
+            break;
         }
-        {
-            std::unique_lock<std::mutex> lck { waiter_mtx_ };
-            if (waiters_.empty()) {
-                waiter_cv_.wait(lck);
-                if (stopped_) {
-                    break;
-                }
-            }
+        // a newly scheduled earlier callback notifies under the lock, so it cannot be missed here
+        auto next = scheduler_->next_expiry();
+        if (next) {
+            waiter_cv_.wait_until(lck, std::max(next.value(), time_point + precision_));
+        } else {
+            waiter_cv_.wait(lck);
         }
-        auto duration = std::chrono::steady_clock::now() - time_point;
-        if (precision_ > duration) {
-            std::this_thread::sleep_for(precision_ - duration);
-        }
-    }
-    std::unique_lock<std::mutex> lck { waiter_mtx_ };
-    {
-        std::priority_queue<WaitOperation, std::vector<WaitOperation>> empty_queue {};
-        waiters_.swap(empty_queue);
     }
+    scheduler_->clear();
     running_ = false;
 }
 
-void Timer::async_wait_for(Duration duration, const Callback& callback) {
-    async_wait_until(std::chrono::steady_clock::now() + duration, callback);
+void Timer::notify() {
+    std::unique_lock<std::mutex> lck { waiter_mtx_ };
+    waiter_cv_.notify_one();
 }
 
-void Timer::async_wait_until(TimePoint time_point, const Callback& callback) {
-    std::unique_lock<std::mutex> lck { waiter_mtx_ };
-    if (waiters_.empty()) {
-        waiters_.push({ time_point, callback });
-        waiter_cv_.notify_one();
-    } else {
-        waiters_.push({ time_point, callback });
-    }
+TimerHandle Timer::async_wait_for(Duration duration, const Callback& callback) {
+    return async_wait_until(std::chrono::steady_clock::now() + duration, callback);
+}
+
+TimerHandle Timer::async_wait_until(TimePoint time_point, const Callback& callback) {
+    return scheduler_->schedule(time_point, callback);
 }
\ No newline at end of file
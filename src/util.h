@@ -1,13 +1,14 @@
 #pragma once
 
-#include <cstring>
 #include <string>
-#include <variant>
+#include <vector>
 
-#include "arpa/inet.h"
 #include "fcntl.h"
-#include "netinet/in.h"
+#include "linux/mempolicy.h"
+#include "sched.h"
 #include "sys/socket.h"
+#include "sys/syscall.h"
+#include "unistd.h"
 
 namespace spinet {
 
@@ -22,24 +23,43 @@ inline void set_reuse_port(int fd) {
     ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option));
 }
 
-inline std::string from_sockaddr_in(const ::sockaddr_in& address) {
-    char buf[std::max(INET_ADDRSTRLEN, INET6_ADDRSTRLEN)] { 0 };
-    ::inet_ntop(address.sin_family, &address.sin_addr, buf, address.sin_family == AF_INET ? INET_ADDRSTRLEN : INET6_ADDRSTRLEN);
-    return { buf };
+// the cpus which this process is allowed to run on, in ascending order
+inline std::vector<int> allowed_cpus() {
+    std::vector<int> cpus {};
+    ::cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return cpus;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
 }
 
-inline std::variant<::sockaddr_in, std::string> to_sockaddr_in(const char* ip, uint16_t port) {
-    ::sockaddr_in address {};
-    address.sin_port = htons(port);
-    if (::inet_pton(AF_INET, ip, &address.sin_addr) == 1) {
-        address.sin_family = AF_INET;
-        return address;
-    } else if (::inet_pton(AF_INET6, ip, &address.sin_addr) == 1) {
-        address.sin_family = AF_INET6;
-        return address;
-    } else {
-        return std::string { "parse failed, reason:" } + std::strerror(errno);
+// the numa node which the cpu belongs to, -1 if it is unknown
+inline int numa_node_of_cpu(int cpu) {
+    for (int node = 0; node < 64; node++) {
+        auto path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/node" + std::to_string(node);
+        if (::access(path.c_str(), F_OK) == 0) {
+            return node;
+        }
     }
+    return -1;
+}
+
+// prefer the numa node for the memory of the range, which must be page aligned and not touched yet
+inline void prefer_numa_node(void* addr, std::size_t size, int node) {
+    unsigned long mask = 1UL << node;
+    ::syscall(SYS_mbind, addr, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+}
+
+// prefer the numa node for the memory first touched by the calling thread
+inline void prefer_numa_node(int node) {
+    unsigned long mask = 1UL << node;
+    ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8);
 }
 
 }
\ No newline at end of file
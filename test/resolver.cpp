@@ -0,0 +1,131 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "resolver.h"
+
+// the resolver runs on a stub lookup, which counts the lookups of each domain and holds the slow ones until they are
+// released. a cached domain is not looked up again until it expires, the lookups of a domain in flight are coalesced,
+// and the lookups still queued when the resolver is destroyed complete with a failure
+
+using Resolver = spinet::Resolver;
+
+class StubLookup {
+    public:
+    Resolver::Resolution lookup(const std::string& domain) {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        lookups_++;
+        if (domain.rfind("slow", 0) == 0) {
+            held_++;
+            cv_.notify_all();
+            cv_.wait(lck, [this]() { return released_; });
+        }
+        auto address = spinet::Address::parse("127.0.0.1", 0);
+        return std::vector<spinet::Address> { std::get<0>(address) };
+    }
+
+    void wait_held(int held) {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        cv_.wait(lck, [this, held]() { return held_ >= held; });
+    }
+
+    void release() {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        released_ = true;
+        cv_.notify_all();
+    }
+
+    int lookups() {
+        std::unique_lock<std::mutex> lck { mtx_ };
+        return lookups_;
+    }
+
+    private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    int lookups_ = 0;
+    int held_ = 0;
+    bool released_ = false;
+};
+
+static bool wait_for(const std::atomic<int>& count, int expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (count < expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return count == expected;
+}
+
+static bool check(bool passed, const char* message) {
+    if (!passed) {
+        std::cerr << message << std::endl;
+    }
+    return passed;
+}
+
+int main() {
+    bool passed = true;
+    {
+        StubLookup stub {};
+        Resolver resolver { [&stub](const std::string& domain) { return stub.lookup(domain); },
+                            std::chrono::milliseconds { 50 }, std::chrono::milliseconds { 50 } };
+
+        // a cache hit, by both resolve and async_resolve
+        auto first = resolver.resolve("cached");
+        auto second = resolver.resolve("cached");
+        bool hit = false;
+        resolver.async_resolve("cached", [&hit](const Resolver::Resolution& resolution) { hit = resolution.index() == 0; });
+        passed &= check(first.index() == 0 && second.index() == 0 && hit && stub.lookups() == 1,
+                        "a cached domain has been looked up again");
+
+        // an expired entry is looked up again
+        std::this_thread::sleep_for(std::chrono::milliseconds { 100 });
+        resolver.resolve("cached");
+        passed &= check(stub.lookups() == 2, "an expired domain has not been looked up again");
+
+        // two lookups of a domain in flight share one lookup
+        std::atomic<int> completed { 0 };
+        std::atomic<int> succeeded { 0 };
+        auto callback = [&](const Resolver::Resolution& resolution) {
+            succeeded += resolution.index() == 0 ? 1 : 0;
+            completed++;
+        };
+        resolver.async_resolve("slow", callback);
+        stub.wait_held(1);
+        resolver.async_resolve("slow", callback);
+        stub.release();
+        passed &= check(wait_for(completed, 2) && succeeded == 2 && stub.lookups() == 3,
+                        "the lookups of a domain in flight have not been coalesced");
+    }
+    {
+        StubLookup stub {};
+        auto resolver = std::make_unique<Resolver>([&stub](const std::string& domain) { return stub.lookup(domain); },
+                                                   Resolver::CACHE_TTL, Resolver::FAILURE_TTL);
+        // every thread is held by a lookup, so the last domain stays queued
+        std::atomic<int> completed { 0 };
+        std::atomic<int> failed { 0 };
+        auto callback = [&](const Resolver::Resolution& resolution) {
+            failed += resolution.index() == 1 ? 1 : 0;
+            completed++;
+        };
+        for (std::size_t i = 0; i < Resolver::THREADS; i++) {
+            resolver->async_resolve("slow" + std::to_string(i), callback);
+        }
+        stub.wait_held(Resolver::THREADS);
+        resolver->async_resolve("queued", callback);
+        std::thread destroying { [&resolver]() { resolver.reset(); } };
+        // let the resolver stop before its threads are released
+        std::this_thread::sleep_for(std::chrono::milliseconds { 200 });
+        stub.release();
+        destroying.join();
+        passed &= check(completed == static_cast<int>(Resolver::THREADS) + 1 && failed == 1,
+                        "the queued lookups have not completed when the resolver was destroyed");
+        passed &= check(stub.lookups() == static_cast<int>(Resolver::THREADS), "a queued lookup ran after the stop");
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "slab_pool.h"
+
+// the blocks of every size class, including an empty request, must be aligned, distinct, writable over their whole
+// size and reused once they are freed
+
+int main() {
+    spinet::SlabPool pool {};
+    bool passed = true;
+    for (std::size_t size : { std::size_t { 0 }, std::size_t { 1 }, spinet::SlabPool::BLOCK_ALIGNMENT,
+         spinet::SlabPool::BLOCK_ALIGNMENT + 1, spinet::SlabPool::MAX_BLOCK_SIZE, spinet::SlabPool::MAX_BLOCK_SIZE + 1 }) {
+        // more than a slab, so a second slab is carved for the size class
+        std::vector<void*> blocks {};
+        std::set<void*> distinct {};
+        for (std::size_t i = 0; i < spinet::SlabPool::BLOCKS_PER_SLAB * 2 + 1; i++) {
+            void* block = pool.allocate(size);
+            if (block == nullptr || reinterpret_cast<uintptr_t>(block) % spinet::SlabPool::BLOCK_ALIGNMENT != 0) {
+                passed = false;
+            }
+            std::memset(block, static_cast<int>(i), size);
+            blocks.push_back(block);
+            distinct.insert(block);
+        }
+        if (distinct.size() != blocks.size()) {
+            passed = false;
+        }
+        void* last = blocks.back();
+        for (auto block : blocks) {
+            pool.deallocate(block, size);
+        }
+        if (size <= spinet::SlabPool::MAX_BLOCK_SIZE && pool.allocate(size) != last) {
+            passed = false;
+        }
+        if (!passed) {
+            std::cerr << "the blocks of " << size << " bytes are broken" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
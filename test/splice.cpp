@@ -0,0 +1,112 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "fcntl.h"
+#include "unistd.h"
+
+#include "spinet.h"
+
+// splice more than the capacity of a pipe, whose writer pauses so that the pipe runs dry while the socket is
+// still writable. the splice must complete with every byte in order
+
+constexpr uint16_t PORT = 19870;
+constexpr std::size_t TOTAL_SIZE = 1024 * 1024;
+
+static uint8_t byte_at(std::size_t i) {
+    return static_cast<uint8_t>(i * 7 + i / 251);
+}
+
+int main() {
+    auto address = spinet::Address::parse("127.0.0.1", PORT);
+    if (address.index() == 1) {
+        std::cerr << std::get<1>(address) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> received(TOTAL_SIZE);
+    std::atomic<bool> received_all { false };
+    std::atomic<std::size_t> received_size { 0 };
+    spinet::Server server {};
+    server.with_settings(spinet::Server::Settings::default_settings());
+    auto error = server.listen_tcp_endpoint(std::get<0>(address), [&](std::shared_ptr<spinet::TcpSocket> socket) {
+        socket->async_read(received.data(), received.size(), [&, socket](spinet::Result res, std::size_t size) {
+            received_size = size;
+            received_all = true;
+        });
+    });
+    if (error) {
+        std::cerr << error.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    server.run();
+
+    spinet::Client client {};
+    client.with_settings(spinet::Client::Settings::default_settings());
+    client.run();
+    auto connected = client.tcp_connect(std::get<0>(address));
+    if (connected.index() == 1) {
+        std::cerr << std::get<1>(connected) << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto socket = std::get<0>(connected);
+
+    int pipe_fds[2];
+    if (::pipe2(pipe_fds, O_CLOEXEC) != 0) {
+        std::cerr << "pipe cannot be created" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::size_t pipe_capacity = static_cast<std::size_t>(::fcntl(pipe_fds[0], F_GETPIPE_SZ));
+
+    std::atomic<bool> spliced { false };
+    std::atomic<std::size_t> spliced_size { 0 };
+    std::atomic<bool> spliced_ok { false };
+    socket->async_splice(pipe_fds[0], TOTAL_SIZE, [&](spinet::Result res, std::size_t size) {
+        spliced_ok = static_cast<bool>(res);
+        spliced_size = size;
+        spliced = true;
+    });
+
+    std::thread writer { [&]() {
+        std::vector<uint8_t> chunk(pipe_capacity / 2);
+        for (std::size_t offset = 0; offset < TOTAL_SIZE; offset += chunk.size()) {
+            std::size_t size = std::min(chunk.size(), TOTAL_SIZE - offset);
+            for (std::size_t i = 0; i < size; i++) {
+                chunk[i] = byte_at(offset + i);
+            }
+            for (std::size_t written = 0; written < size;) {
+                auto bytes = ::write(pipe_fds[1], chunk.data() + written, size - written);
+                if (bytes <= 0) {
+                    return;
+                }
+                written = written + bytes;
+            }
+            // let the runtime drain the pipe before it is refilled
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    } };
+    writer.join();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((!spliced || !received_all) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    bool passed = spliced && spliced_ok && spliced_size == TOTAL_SIZE && received_all && received_size == TOTAL_SIZE;
+    for (std::size_t i = 0; passed && i < TOTAL_SIZE; i++) {
+        passed = received[i] == byte_at(i);
+    }
+    if (!passed) {
+        std::cerr << "splice of " << TOTAL_SIZE << " bytes through a pipe of " << pipe_capacity << " bytes failed, spliced "
+                  << spliced_size << ", received " << received_size << std::endl;
+    }
+
+    socket->close();
+    ::close(pipe_fds[0]);
+    ::close(pipe_fds[1]);
+    client.stop();
+    server.stop();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "spinet/core/task_queue.h"
+
+// several producers push into a small ring, so the elements keep spilling over and the ring keeps reopening. the
+// consumer holds the front for a while before popping it, like a socket holds a task across its syscalls. every
+// element must be consumed exactly once, in the order of its producer
+
+constexpr std::size_t PRODUCERS = 4;
+constexpr uint64_t PUSHES = 200000;
+constexpr uint32_t ALIVE = 0x5a5a5a5a;
+
+struct Item {
+    Item(std::size_t producer, uint64_t sequence)
+    : producer { producer }
+    , sequence { sequence }
+    , magic { ALIVE } {
+    }
+    Item(Item&& other) = delete;
+    ~Item() {
+        magic = 0;
+    }
+
+    std::size_t producer;
+    uint64_t sequence;
+    uint32_t magic;
+};
+
+int main() {
+    spinet::TaskQueue<Item, 4> queue {};
+    std::atomic<bool> start { false };
+    std::vector<std::thread> producers {};
+    for (std::size_t p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&queue, &start, p]() {
+            while (!start) {
+            }
+            for (uint64_t i = 0; i < PUSHES; i++) {
+                queue.push(p, i);
+            }
+        });
+    }
+    start = true;
+
+    std::vector<uint64_t> expected(PRODUCERS, 0);
+    uint64_t consumed = 0;
+    uint64_t iterations = 0;
+    bool passed = true;
+    while (passed && consumed < PRODUCERS * PUSHES) {
+        Item* item = queue.front();
+        if (item == nullptr) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (++iterations % 7 == 0) {
+            // widen the window in which a producer may publish while the front is held
+            std::this_thread::yield();
+        }
+        Item* again = queue.front();
+        if (again != item || item->magic != ALIVE || item->producer >= PRODUCERS ||
+        item->sequence != expected[item->producer]) {
+            std::cerr << "unexpected element after " << consumed << " pops" << std::endl;
+            passed = false;
+            break;
+        }
+        expected[item->producer]++;
+        queue.pop();
+        consumed++;
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    if (passed && queue.front() != nullptr) {
+        std::cerr << "the queue is not empty after all the elements are consumed" << std::endl;
+        passed = false;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,75 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "spinet/core/timing_wheel.h"
+
+// a node is cancelled and destroyed on another thread while its expiry is running. the cancellation must wait until
+// on_expired has returned, otherwise the expiring thread would go on with a destroyed node
+
+constexpr uint32_t ALIVE = 0x5a5a5a5a;
+
+class SlowTimer : public spinet::TimerNode {
+    public:
+    SlowTimer()
+    : started { false }
+    , finished { false }
+    , magic { ALIVE } {
+    }
+    ~SlowTimer() {
+        magic = 0;
+    }
+
+    std::atomic<bool> started;
+    std::atomic<bool> finished;
+    uint32_t magic;
+
+    protected:
+    void on_expired(TimePoint time_point, TimePoint now) override {
+        started = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        finished = magic == ALIVE;
+    }
+};
+
+int main() {
+    auto scheduler = std::make_shared<spinet::TimerScheduler>();
+    auto timer = std::make_unique<SlowTimer>();
+    auto now = spinet::TimerScheduler::Clock::now();
+    scheduler->schedule(timer.get(), now);
+
+    std::thread expiring { [&]() { scheduler->expire(now + std::chrono::milliseconds(10)); } };
+    while (!timer->started) {
+        std::this_thread::yield();
+    }
+    scheduler->cancel(timer.get());
+    bool passed = timer->finished;
+    timer.reset();
+    expiring.join();
+
+    // a node cancelling itself from on_expired must not wait for itself
+    class SelfCancellingTimer : public spinet::TimerNode {
+        public:
+        explicit SelfCancellingTimer(spinet::TimerScheduler* scheduler)
+        : scheduler_ { scheduler } {
+        }
+
+        protected:
+        void on_expired(TimePoint time_point, TimePoint now) override {
+            scheduler_->cancel(this);
+        }
+
+        private:
+        spinet::TimerScheduler* scheduler_;
+    };
+    SelfCancellingTimer self_cancelling { scheduler.get() };
+    scheduler->schedule(&self_cancelling, now);
+    scheduler->expire(now + std::chrono::milliseconds(10));
+
+    if (!passed) {
+        std::cerr << "cancel returned before the expiry in flight had finished" << std::endl;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
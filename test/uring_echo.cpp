@@ -0,0 +1,114 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "spinet.h"
+
+// echo over loopback with both ends on the io_uring backend, the connections are accepted by its multishot accept.
+// every connection must get back the bytes it sent in order. it runs on epoll where io_uring is unavailable
+
+constexpr uint16_t PORT = 19871;
+constexpr std::size_t CONNECTIONS = 16;
+constexpr std::size_t TOTAL_SIZE = 256 * 1024;
+
+static uint8_t byte_at(std::size_t connection, std::size_t i) {
+    return static_cast<uint8_t>(i * 7 + i / 251 + connection);
+}
+
+static void echo(std::shared_ptr<spinet::TcpSocket> socket, std::shared_ptr<std::vector<uint8_t>> buf) {
+    socket->async_read_some(buf->data(), buf->size(), [socket, buf](spinet::Result res, std::size_t size) {
+        if (!res) {
+            socket->close();
+            return;
+        }
+        socket->async_write(buf->data(), size, [socket, buf](spinet::Result res, std::size_t) {
+            if (!res) {
+                socket->close();
+                return;
+            }
+            echo(socket, buf);
+        });
+    });
+}
+
+int main() {
+    auto address = spinet::Address::parse("127.0.0.1", PORT);
+    if (address.index() == 1) {
+        std::cerr << std::get<1>(address) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    spinet::Server server {};
+    auto server_settings = spinet::Server::Settings::default_settings();
+    server_settings.backend = spinet::Backend::URING_POLL;
+    server.with_settings(server_settings);
+    auto error = server.listen_tcp_endpoint(std::get<0>(address), [](std::shared_ptr<spinet::TcpSocket> socket) {
+        echo(socket, std::make_shared<std::vector<uint8_t>>(16 * 1024));
+    });
+    if (error) {
+        std::cerr << error.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    server.run();
+
+    spinet::Client client {};
+    auto client_settings = spinet::Client::Settings::default_settings();
+    client_settings.backend = spinet::Backend::URING_POLL;
+    client.with_settings(client_settings);
+    client.run();
+
+    std::vector<std::shared_ptr<spinet::TcpSocket>> sockets {};
+    std::vector<std::vector<uint8_t>> sent(CONNECTIONS);
+    std::vector<std::vector<uint8_t>> received(CONNECTIONS);
+    std::atomic<std::size_t> finished { 0 };
+    std::atomic<std::size_t> failed { 0 };
+    for (std::size_t c = 0; c < CONNECTIONS; c++) {
+        auto connected = client.tcp_connect(std::get<0>(address));
+        if (connected.index() == 1) {
+            std::cerr << std::get<1>(connected) << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto socket = std::get<0>(connected);
+        sockets.push_back(socket);
+        sent[c].resize(TOTAL_SIZE);
+        received[c].resize(TOTAL_SIZE);
+        for (std::size_t i = 0; i < TOTAL_SIZE; i++) {
+            sent[c][i] = byte_at(c, i);
+        }
+        socket->async_read(received[c].data(), TOTAL_SIZE, [&](spinet::Result res, std::size_t size) {
+            if (!res || size != TOTAL_SIZE) {
+                failed++;
+            }
+            finished++;
+        });
+        socket->async_write(sent[c].data(), TOTAL_SIZE, [&](spinet::Result res, std::size_t size) {
+            if (!res || size != TOTAL_SIZE) {
+                failed++;
+            }
+        });
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while (finished < CONNECTIONS && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    bool passed = finished == CONNECTIONS && failed == 0;
+    for (std::size_t c = 0; passed && c < CONNECTIONS; c++) {
+        passed = received[c] == sent[c];
+    }
+    if (!passed) {
+        std::cerr << "echo of " << CONNECTIONS << " connections failed, " << finished << " finished, " << failed
+                  << " failed" << std::endl;
+    }
+
+    for (auto& socket : sockets) {
+        socket->close();
+    }
+    client.stop();
+    server.stop();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file